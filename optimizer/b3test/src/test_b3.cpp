@@ -15,6 +15,7 @@
 #include "problem.h"
 #include "solution.h"
 #include "solver.h"
+#include "threesum.h"
 
 int main() {
     optimizer::Environment env;
@@ -25,7 +26,10 @@ int main() {
     of.open("b3_time.tsv", std::ios::out | std::ios::trunc);
     assert(of.is_open());
 
-    of << "M\tM'\tN\tN'\tW\tT\n";
+    // B3 draws from the 3-partitions a Problem enumerates when it is
+    // created, so T times B3 alone and E the enumeration, as done there
+    std::cout << "E: 3-partition enumeration time, T: B3 time\n";
+    of << "M\tM'\tN\tN'\tW\tE\tT\n";
 
     for (const auto &item_count : item_counts) {
         const auto &bin_capacity = item_count;
@@ -37,22 +41,31 @@ int main() {
                           [&size_dist, &env] { return size_dist(*env.rng()); });
             optimizer::Problem problem(&env, item_sizes.cbegin(),
                                        item_sizes.cend(), bin_capacity);
+            std::chrono::time_point<std::chrono::high_resolution_clock>
+                enumeration_start = std::chrono::high_resolution_clock::now();
+            optimizer::ThreeSum three_sum(problem.items().cbegin(),
+                                          problem.items().cend());
+            std::vector<optimizer::Partition> partitions;
+            three_sum(&partitions, problem.bin_capacity());
+            three_sum(&partitions, 2u * problem.bin_capacity());
+            std::chrono::duration<double> enumeration_duration =
+                std::chrono::high_resolution_clock::now() - enumeration_start;
             optimizer::Solution s{};
-            auto items(problem.items());
+            auto context = problem.context();
             auto slack = problem.slack();
             auto actual_item_count = problem.item_count();
             s.items().reserve(problem.item_count());
             s.blocks().reserve((problem.item_count() + slack) / 3u);
             std::chrono::time_point<std::chrono::high_resolution_clock> start =
                 std::chrono::high_resolution_clock::now();
-            problem.b3(items.begin(), items.end(), &slack, &actual_item_count,
-                       &s);
+            problem.b3(&context, &slack, &actual_item_count, &s);
             std::chrono::duration<double> duration =
                 std::chrono::high_resolution_clock::now() - start;
             of << problem.original_bin_count() << '\t' << problem.bin_count()
                << '\t' << problem.original_item_count() << '\t'
                << problem.item_count() << '\t' << problem.unique_size_count()
-               << '\t' << duration.count() << '\n';
+               << '\t' << enumeration_duration.count() << '\t'
+               << duration.count() << '\n';
         }
     }
     of.close();
@@ -14,15 +14,19 @@
 #include <vector>
 
 #include "environment.h"
+#include "parameters.h"
+#include "population.h"
 #include "problem.h"
 #include "solution.h"
 #include "solver.h"
+#include "thread_pool.h"
 
 int main() {
     optimizer::Environment env;
+    optimizer::ThreadPool pool;
 
     const std::uint32_t runs = 10;
-    const std::uint32_t NP = 100;
+    const optimizer::Parameters params{};
 
     std::array<std::string, 6> names{
         {"bc_if", "bc_il", "bc_is", "bi_if", "bi_il", "bi_is"}};
@@ -82,9 +86,10 @@ int main() {
 
                 auto e1e2_start = std::chrono::high_resolution_clock::now();
                 optimizer::Problem problem(&env, items.cbegin(), items.cend(),
-                                           c, bin_count);
+                                           c, bin_count, &pool);
                 std::chrono::duration<double> duration_e1e2 =
                     std::chrono::high_resolution_clock::now() - e1e2_start;
+                auto context = problem.context();
                 for (auto i = 0u; i < runs; ++i) {
                     // reset seed
                     env.reseed();
@@ -92,7 +97,8 @@ int main() {
 
                     auto g_start = std::chrono::high_resolution_clock::now();
                     // run g
-                    auto solution_g = problem.generate_individual<false>();
+                    auto solution_g =
+                        problem.generate_individual<false>(&context);
                     std::chrono::duration<double> duration_g =
                         std::chrono::high_resolution_clock::now() - g_start;
 
@@ -101,7 +107,7 @@ int main() {
 
                     auto b3g_start = std::chrono::high_resolution_clock::now();
                     // run b3g
-                    auto solution_b3g = problem.generate_individual();
+                    auto solution_b3g = problem.generate_individual(&context);
                     std::chrono::duration<double> duration_b3g =
                         std::chrono::high_resolution_clock::now() - b3g_start;
 
@@ -109,22 +115,18 @@ int main() {
                     env.reseed(seed);
 
                     // do genetic
-                    std::array<std::unique_ptr<optimizer::Solution>, NP>
-                        population;
+                    optimizer::Population population(params.np);
                     optimizer::Solution solution_stage1;
                     auto found_optimal = false;
 
                     auto stage1_start =
                         std::chrono::high_resolution_clock::now();
-                    for (auto j = 0u; j < population.size(); ++j) {
-                        population[j] = problem.generate_individual();
-
-                        if (problem.bin_count() - population[j]->size() ==
-                            problem.lower_bound()) {
-                            solution_stage1 = std::move(*population[j]);
-                            found_optimal = true;
-                            break;
-                        }
+                    const auto j = optimizer::generate_population(
+                        problem, &pool, &population);
+
+                    if (j < population.size()) {
+                        solution_stage1 = std::move(*population[j]);
+                        found_optimal = true;
                     }
 
                     std::chrono::duration<double> duration_stage1;
@@ -159,8 +161,9 @@ int main() {
                     if (!found_optimal) {
                         auto stage2_start =
                             std::chrono::high_resolution_clock::now();
-                        solution_stage2 = optimizer::Solver<NP>(&problem).solve(
-                            &population, &gen, &blocks_over_time);
+                        solution_stage2 =
+                            optimizer::Solver(&problem, params)
+                                .solve(&population, &gen, &blocks_over_time);
                         duration_stage2 =
                             std::chrono::high_resolution_clock::now() -
                             stage2_start;
@@ -0,0 +1,94 @@
+#ifndef BLOCK_RNG_H_
+#define BLOCK_RNG_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+
+#include <pcg_random.hpp>
+
+namespace optimizer {
+
+/*
+ * A random bit generator made of `lanes` interleaved PCG32 (XSH RR) streams,
+ * which produces `block_size` outputs at a time. The lanes are independent,
+ * so a block is computed with vector instructions where available. Outputs are
+ * taken a block at a time with `next_block`, or one at a time from a buffered
+ * block as a UniformRandomBitGenerator.
+ */
+class BlockRng {
+ public:
+    typedef std::uint32_t result_type;
+    static constexpr std::uint32_t lanes = 32u;
+    static constexpr std::uint32_t block_size = 4u * lanes;
+    typedef std::array<result_type, block_size> Block;
+
+ private:
+    static constexpr std::uint64_t multiplier = 6364136223846793005u;
+
+    std::array<std::uint64_t, lanes> state_;
+    std::array<std::uint64_t, lanes> increment_;
+    Block block_;
+    std::uint32_t next_;
+
+ public:
+    explicit BlockRng(std::uint64_t seed, std::uint64_t stream = 0u)
+        : state_{}, increment_{}, block_{}, next_{block_size} {
+        this->seed(seed, stream);
+    }
+    /*
+     * Seeds the lanes from sub-stream stream of seed, each lane on a PCG
+     * stream of its own.
+     */
+    void seed(std::uint64_t seed, std::uint64_t stream = 0u) {
+        pcg32 seeder(seed, lanes);
+        seeder.advance(2u * lanes * stream);
+        for (auto i = 0u; i < lanes; ++i) {
+            increment_[i] = static_cast<std::uint64_t>(i) << 1u | 1u;
+            const auto init =
+                static_cast<std::uint64_t>(seeder()) << 32u | seeder();
+            state_[i] = (increment_[i] + init) * multiplier + increment_[i];
+        }
+        next_ = block_size;
+    }
+    /*
+     * Returns the next block of outputs, which stays valid until the next
+     * call. Buffered outputs not yet taken one at a time are skipped.
+     */
+    const Block &next_block() {
+        for (auto j = 0u; j < block_size; j += lanes) {
+            // a local row keeps the stores apart from the states, so the
+            // lanes are vectorised
+            std::array<result_type, lanes> row;
+            for (auto i = 0u; i < lanes; ++i) {
+                const auto old = state_[i];
+                state_[i] = old * multiplier + increment_[i];
+                const auto x =
+                    static_cast<std::uint32_t>(((old >> 18u) ^ old) >> 27u);
+                const auto r = static_cast<std::uint32_t>(old >> 59u);
+                row[i] = x >> r | x << ((32u - r) & 31u);
+            }
+            std::copy(row.cbegin(), row.cend(), block_.begin() + j);
+        }
+        next_ = block_size;
+        return block_;
+    }
+    result_type operator()() {
+        if (next_ == block_size) {
+            next_block();
+            next_ = 0u;
+        }
+        return block_[next_++];
+    }
+    static constexpr result_type min() {
+        return std::numeric_limits<result_type>::min();
+    }
+    static constexpr result_type max() {
+        return std::numeric_limits<result_type>::max();
+    }
+};
+
+} // namespace optimizer
+
+#endif
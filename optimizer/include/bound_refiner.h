@@ -0,0 +1,68 @@
+#ifndef BOUND_REFINER_H_
+#define BOUND_REFINER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "lower_bound.h"
+#include "problem.h"
+
+namespace optimizer {
+
+/*
+ * Tightens the lower bound of a `Problem` on a thread of its own while the
+ * problem is being solved, so that solvers checking `Problem::lower_bound`
+ * may stop sooner. In each of a number of rounds, `l3star` and `ccm_bound`
+ * are run with twice the effort of the round before, starting at twice that
+ * of the `Problem` constructor. The given bounds run after the last round.
+ * The refiner stops early when asked to, between two bounds.
+ */
+class BoundRefiner {
+    std::atomic<bool> stop_;
+    std::thread thread_;
+
+ public:
+    BoundRefiner(Problem *problem, std::vector<BinBound> bounds = {},
+                 std::uint32_t rounds = 4u)
+        : stop_{false}, thread_{} {
+        thread_ = std::thread([this, problem, rounds,
+                               bounds = std::move(bounds)] {
+            for (auto r = 1u; r <= rounds && !stop_.load(); ++r) {
+                problem->tighten_l3star(20u << r);
+                if (stop_.load()) {
+                    return;
+                }
+                problem->tighten([r](const std::vector<ItemCount> &items,
+                                     std::uint32_t bin_capacity) {
+                    return ccm_bound(items.cbegin(), items.cend(),
+                                     bin_capacity, 64u << r);
+                });
+            }
+            for (const auto &bound : bounds) {
+                if (stop_.load()) {
+                    return;
+                }
+                problem->tighten(bound);
+            }
+        });
+    }
+    BoundRefiner(const BoundRefiner &) = delete;
+    BoundRefiner &operator=(const BoundRefiner &) = delete;
+    ~BoundRefiner() { stop(); }
+    /*
+     * Asks the refiner to stop and waits until it has.
+     */
+    void stop() {
+        stop_.store(true);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+};
+
+} // namespace optimizer
+
+#endif
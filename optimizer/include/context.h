@@ -0,0 +1,70 @@
+#ifndef CONTEXT_H_
+#define CONTEXT_H_
+
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "environment.h"
+#include "item.h"
+#include "solution.h"
+#include "util.h"
+
+namespace optimizer {
+
+/*
+ * A `Context` holds the mutable state used by the operators working on a
+ * `Problem`: the random bit generator, scratch item counts mirroring the items
+ * of the problem, the order in which 3-partitions are tried or the weights
+ * from which they are drawn, a spare `Solution` to build into, scratch blocks
+ * and a sampler. Operators running at the same time must use distinct
+ * contexts.
+ */
+class Context {
+    Environment *env_;
+    std::vector<ItemCount> items_;
+    std::vector<std::uint32_t> partitions_;
+    WeightTree weights_;
+    Solution spare_;
+    std::vector<Solution::Block> blocks_;
+    CountSampler sampler_;
+
+ public:
+    Context(Environment *env, const std::vector<ItemCount> &items,
+            std::uint32_t partition_count)
+        : env_{env}, items_(items), partitions_(partition_count), weights_{},
+          spare_{}, blocks_{}, sampler_{} {
+        restart();
+    }
+    Environment *env() const { return env_; }
+    /*
+     * Scratch counts, index for index equal to the items of the `Problem`.
+     * Every operator leaves them as it found them.
+     */
+    std::vector<ItemCount> &items() { return items_; }
+    std::vector<std::uint32_t> &partitions() { return partitions_; }
+    WeightTree &weights() { return weights_; }
+    /*
+     * A solution whose storage operators may swap with their own.
+     */
+    Solution &spare() { return spare_; }
+    /*
+     * Blocks for temporary use within an operator.
+     */
+    std::vector<Solution::Block> &blocks() { return blocks_; }
+    /*
+     * A sampler for drawing items in random order from their counts.
+     */
+    CountSampler &sampler() { return sampler_; }
+    /*
+     * Restores the initial order of the 3-partitions, so that the next
+     * operator depends on the random bit generator only.
+     */
+    void restart() {
+        std::iota(partitions_.begin(), partitions_.end(), std::uint32_t{});
+    }
+};
+
+} // namespace optimizer
+
+#endif
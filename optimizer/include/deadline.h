@@ -0,0 +1,46 @@
+#ifndef DEADLINE_H_
+#define DEADLINE_H_
+
+#include <chrono>
+
+namespace optimizer {
+
+/*
+ * A point in time by which a solver must return. Being absolute, a deadline
+ * taken when a job arrives also accounts for the time spent before solving,
+ * such as reducing the problem and generating the population. The default
+ * deadline never passes.
+ */
+class Deadline {
+ public:
+    typedef std::chrono::steady_clock Clock;
+
+ private:
+    Clock::time_point time_;
+
+ public:
+    Deadline() : time_{Clock::time_point::max()} {}
+    explicit Deadline(Clock::time_point time) : time_{time} {}
+    /*
+     * Returns the deadline which is budget from now.
+     */
+    template <class Rep, class Period>
+    static Deadline after(std::chrono::duration<Rep, Period> budget) {
+        return Deadline(Clock::now() +
+                        std::chrono::duration_cast<Clock::duration>(budget));
+    }
+    Clock::time_point time() const { return time_; }
+    bool none() const { return time_ == Clock::time_point::max(); }
+    /*
+     * Determines if a step starting at now and lasting step would end after
+     * the deadline.
+     */
+    bool passed(Clock::time_point now,
+                Clock::duration step = Clock::duration::zero()) const {
+        return now + step > time_;
+    }
+};
+
+} // namespace optimizer
+
+#endif
@@ -1,33 +1,61 @@
 #ifndef ENVIRONMENT_H_
 #define ENVIRONMENT_H_
 
+#include <assert.h>
+
 #include <climits>
 #include <cstdint>
+#include <memory>
 #include <random>
 
 #include <pcg_random.hpp>
 
+#include "block_rng.h"
+
 namespace optimizer {
 
 /*
- * The `Environment` class contains random state and random bit generators.
+ * The `Environment` class contains random state and random bit generators:
+ * a `pcg32_fast` for drawing one number at a time, and a `BlockRng` on other
+ * streams for kernels which consume random numbers in blocks. Both are seeded
+ * from the same seed. The `BlockRng` is large, so it is only made and seeded
+ * when it is first asked for after a reseed.
+ *
+ * A seed has sub-streams: sub-stream s starts s * `stream_stride` draws into
+ * the sequence of the seed, so up to 2^26 sub-streams do not overlap. An
+ * environment on sub-stream 0 hands out the others with `split`, for
+ * workers, islands and individuals which must not depend on each other.
  */
 class Environment {
     std::random_device rd_;
     pcg32_fast::state_type seed_;
+    std::uint64_t stream_;
+    std::uint64_t streams_;
     pcg32_fast rng_;
+    std::unique_ptr<BlockRng> block_rng_;
+    bool block_seeded_;
 
  public:
-    explicit Environment(pcg32_fast::state_type seed)
-        : rd_{}, seed_{seed}, rng_{seed_} {}
+    static constexpr std::uint64_t stream_stride = std::uint64_t{1} << 36u;
+
+    explicit Environment(pcg32_fast::state_type seed, std::uint64_t stream = 0u)
+        : rd_{}, seed_{seed}, stream_{}, streams_{}, rng_{seed_},
+          block_rng_{}, block_seeded_{false} {
+        if (stream) {
+            reseed(seed, stream);
+        }
+    }
 #if UINT_MAX >= UINT64_MAX
-    Environment() : rd_{}, seed_(rd_()), rng_{seed_} {}
+    Environment()
+        : rd_{}, seed_(rd_()), stream_{}, streams_{}, rng_{seed_},
+          block_rng_{}, block_seeded_{false} {}
     void reseed() { reseed(rd_()); }
 #elif UINT_MAX >= UINT32_MAX
     Environment()
         : rd_{},
           seed_(static_cast<pcg32_fast::state_type>(rd_()) << 32u | rd_()),
-          rng_{seed_} {}
+          stream_{}, streams_{}, rng_{seed_}, block_rng_{},
+          block_seeded_{false} {}
     void reseed() {
         reseed(static_cast<pcg32_fast::state_type>(rd_()) << 32u | rd_());
     }
@@ -35,10 +63,39 @@ class Environment {
 #error Does not compute
 #endif
     pcg32_fast *rng() { return &rng_; }
+    BlockRng *block_rng() {
+        if (!block_rng_) {
+            block_rng_ = std::make_unique<BlockRng>(seed_, stream_);
+        } else if (!block_seeded_) {
+            block_rng_->seed(seed_, stream_);
+        }
+        block_seeded_ = true;
+        return block_rng_.get();
+    }
     pcg32_fast::state_type seed() const { return seed_; }
-    void reseed(pcg32_fast::state_type seed) {
+    std::uint64_t stream() const { return stream_; }
+    /*
+     * Restarts the generators on sub-stream stream of seed.
+     */
+    void reseed(pcg32_fast::state_type seed, std::uint64_t stream = 0u) {
         seed_ = seed;
+        stream_ = stream;
+        streams_ = 0u;
         rng_.seed(seed);
+        rng_.advance(stream * stream_stride);
+        block_seeded_ = false;
+    }
+    /*
+     * Reserves n sub-streams of the seed and returns the number of the first.
+     * Sub-streams are handed out from 1 on in the order they are reserved, so
+     * a program which reserves them in a fixed order gets the same ones in
+     * every run with the same seed.
+     */
+    std::uint64_t split(std::uint64_t n) {
+        assert(stream_ == 0u);
+        const auto first = streams_ + 1u;
+        streams_ += n;
+        return first;
     }
 };
 
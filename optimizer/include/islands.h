@@ -0,0 +1,242 @@
+#ifndef ISLANDS_H_
+#define ISLANDS_H_
+
+#include <assert.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "deadline.h"
+#include "environment.h"
+#include "parameters.h"
+#include "problem.h"
+#include "progress.h"
+#include "solution.h"
+#include "solver.h"
+#include "thread_pool.h"
+
+namespace optimizer {
+
+/*
+ * The `IslandSolver` class runs the grouping genetic algorithm of `Solver` on
+ * several populations, islands, at once. Each island has a `Context` of its
+ * own, on a sub-stream of the environment of the problem. Every `mi`
+ * generations the `ni` best individuals of each island replace the worst
+ * individuals of the next island in a ring. Termination is decided over all
+ * islands together. The remaining parameters are those of `Solver`.
+ */
+class IslandSolver {
+    const Problem *problem_;
+    ThreadPool *pool_;
+    Parameters params_;
+    Deadline deadline_;
+    BestCallback on_best_;
+    Progress *progress_;
+
+ public:
+    IslandSolver(const Problem *problem, ThreadPool *pool,
+                 const Parameters &params = Parameters())
+        : problem_(problem), pool_(pool), params_(params), deadline_{},
+          on_best_{}, progress_(nullptr) {
+        assert(params_.valid());
+    }
+    IslandSolver(const IslandSolver &) = delete;
+    IslandSolver &operator=(const IslandSolver &) = delete;
+    /*
+     * As for `Solver`. Each island checks the deadline before each of its
+     * generations, and all of them stop after an epoch in which one has
+     * found it passed.
+     */
+    void set_deadline(const Deadline &deadline) { deadline_ = deadline; }
+    /*
+     * As for `Solver`, called between epochs with the best over all islands.
+     */
+    void set_on_best(BestCallback on_best) { on_best_ = std::move(on_best); }
+    /*
+     * As for `Solver`, with progress published between epochs. Each island
+     * checks for a cancel before each of its generations.
+     */
+    void set_progress(Progress *progress) { progress_ = progress; }
+    /*
+     * Evolves the islands, which must be sorted by decreasing size, until the
+     * lower bound is reached, `ng` generations have passed or the best
+     * solution over all islands has not improved for `dl` generations. Each
+     * island must hold `np` individuals.
+     */
+    Solution
+    solve(std::vector<Population> *islands, std::uint32_t *gen = nullptr,
+          std::vector<std::uint32_t> *blocks_over_time = nullptr) const {
+        const auto n = static_cast<std::uint32_t>(islands->size());
+        const auto np = params_.np;
+        const auto ni = params_.ni;
+        std::vector<std::unique_ptr<Environment>> envs;
+        std::vector<Solver> solvers;
+        envs.reserve(n);
+        solvers.reserve(n);
+
+        const auto seed = problem_->env()->seed();
+        const auto first = problem_->env()->split(n);
+        for (auto i = 0u; i < n; ++i) {
+            envs.push_back(std::make_unique<Environment>(seed, first + i));
+            solvers.emplace_back(problem_, envs.back().get(), params_);
+        }
+
+        std::vector<Solution> island_best;
+        island_best.reserve(n);
+        for (const auto &population : *islands) {
+            assert(population.size() == np);
+            island_best.push_back(*population[0]);
+        }
+
+        const auto best_of = [&island_best]() {
+            return std::max_element(island_best.cbegin(), island_best.cend(),
+                                    [](const auto &l, const auto &r) {
+                                        return l.size() < r.size();
+                                    }) -
+                   island_best.cbegin();
+        };
+
+        auto best_island = best_of();
+        Solution best_solution(island_best[best_island]);
+        auto generation = std::uint32_t{};
+        auto previous = best_solution.size();
+        auto delta_counter = std::uint32_t{};
+        std::vector<std::vector<std::uint32_t>> bests(n);
+        std::vector<Solution> migrants(n > 1u ? n * ni : 0u);
+        Population buffer;
+        std::vector<std::uint32_t> counts;
+        const auto timed = !deadline_.none();
+        std::vector<Deadline::Clock::duration> durations(
+            n, Deadline::Clock::duration::zero());
+        std::vector<char> stopped(n);
+
+        if (on_best_) {
+            on_best_(best_solution, generation);
+        }
+        if (progress_) {
+            progress_->reset(best_solution.size());
+        }
+
+        while (generation < params_.ng &&
+               problem_->bin_count() - best_solution.size() >
+                   problem_->lower_bound() &&
+               delta_counter < params_.dl) {
+            const auto epoch = std::min(params_.mi, params_.ng - generation);
+
+            // an island stops early only on reaching the lower bound itself,
+            // so that every island evolves the same in every run, unless the
+            // deadline passes or the solve is cancelled
+            pool_->parallel_for(n, [&](std::uint32_t i) {
+                auto &solver = solvers[i];
+                auto &population = (*islands)[i];
+                auto &best = island_best[i];
+                auto last = Deadline::Clock::time_point{};
+                bests[i].clear();
+                for (auto j = 0u; j < epoch; ++j) {
+                    if (progress_ && progress_->cancelled()) {
+                        stopped[i] = true;
+                        break;
+                    }
+                    if (timed) {
+                        const auto now = Deadline::Clock::now();
+                        if (j) {
+                            durations[i] = now - last;
+                        }
+                        last = now;
+                        if (deadline_.passed(now, durations[i])) {
+                            stopped[i] = true;
+                            break;
+                        }
+                    }
+                    solver.evolve(&population);
+                    if (population[0]->size() > best.size()) {
+                        best = *population[0];
+                    }
+                    bests[i].push_back(best.size());
+                    if (problem_->bin_count() - best.size() ==
+                        problem_->lower_bound()) {
+                        break;
+                    }
+                }
+            });
+
+            const auto steps = std::max_element(bests.cbegin(), bests.cend(),
+                                                [](const auto &l,
+                                                   const auto &r) {
+                                                    return l.size() < r.size();
+                                                })
+                                   ->size();
+            auto improved = false;
+            auto found = generation;
+
+            for (auto j = 0u; j < steps && delta_counter < params_.dl; ++j) {
+                auto current = previous;
+                for (const auto &b : bests) {
+                    if (!b.empty()) {
+                        const auto k = std::min<std::size_t>(j, b.size() - 1u);
+                        current = std::max(current, b[k]);
+                    }
+                }
+                if (current == previous) {
+                    ++delta_counter;
+                } else {
+                    previous = current;
+                    delta_counter = 0u;
+                    improved = true;
+                    found = generation + 1u;
+                }
+                ++generation;
+                if (progress_) {
+                    progress_->update(generation, previous,
+                                      found == generation);
+                }
+                if (blocks_over_time) {
+                    blocks_over_time->push_back(previous);
+                }
+            }
+
+            if (improved) {
+                best_island = best_of();
+                best_solution = island_best[best_island];
+                if (on_best_) {
+                    on_best_(best_solution, found);
+                }
+            }
+
+            if (std::find(stopped.cbegin(), stopped.cend(), true) !=
+                stopped.cend()) {
+                break;
+            }
+
+            if (n > 1u) {
+                for (auto i = 0u; i < n; ++i) {
+                    for (auto j = 0u; j < ni; ++j) {
+                        migrants[i * ni + j] = *(*islands)[i][j];
+                    }
+                }
+                for (auto i = 0u; i < n; ++i) {
+                    const auto from = (i + n - 1u) % n;
+                    auto &population = (*islands)[i];
+                    for (auto j = 0u; j < ni; ++j) {
+                        std::swap(*population[np - ni + j],
+                                  migrants[from * ni + j]);
+                    }
+                    sort_population(population.begin(), population.end(),
+                                    &buffer, &counts);
+                }
+            }
+        }
+
+        if (gen) {
+            *gen = generation;
+        }
+
+        return best_solution;
+    }
+};
+
+} // namespace optimizer
+
+#endif
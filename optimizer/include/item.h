@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <iostream>
+#include <limits>
 
 namespace optimizer {
 
@@ -20,6 +21,12 @@ struct ItemCount {
     }
 };
 
+/*
+ * Index standing for a dummy item, which marks where slack may be used in a
+ * packing, in arrays of indices into the items of a `Problem`.
+ */
+constexpr std::uint32_t dummy_item = std::numeric_limits<std::uint32_t>::max();
+
 } // namespace optimizer
 
 #endif
@@ -2,69 +2,74 @@
 #define LOWER_BOUND_H_
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <iterator>
 #include <numeric>
 #include <utility>
 #include <vector>
 
+#include "item.h"
+#include "thread_pool.h"
+
 namespace optimizer {
 
 /*
  * Packs items into bins using First Fit with a maximum of two items per bin.
- * Uses a segment tree for efficient implementation in O(n log n).
+ * The loads of the bins are kept in an implicit segment tree of minima, with
+ * the root at index 1 and the leaves in the second half, which is searched
+ * top-down and repaired bottom-up without recursion, in O(n log n) overall.
+ * A full bin has load c, so it takes no further items.
  */
 class Fitter {
  public:
     Fitter(std::uint32_t n, std::uint32_t c)
-        : n_(n), c_(c), st_(n << 2u), bins_() {
+        : leaves_(leaves(n)), c_(c), st_(2u * leaves_, 0u), bins_() {
         bins_.reserve(n);
     }
-
-    constexpr static auto mid(std::uint32_t left, std::uint32_t right) {
-        return (left + right) >> 1u;
-    }
-
-    std::uint32_t query(std::uint32_t idx, std::uint32_t val,
-                        std::uint32_t left, std::uint32_t right) {
-        if (left == right) {
-            return left;
-        }
-
-        if (st_[2u * idx] <= c_ - val) {
-            return query(2u * idx, val, left, mid(left, right));
-        } else {
-            return query(2u * idx + 1u, val, mid(left, right) + 1u, right);
+    /*
+     * Packs a single item of size val.
+     */
+    void fit(std::uint32_t val) { fit_many(val, 1u); }
+    /*
+     * Packs count items of size val, as if by calling fit count times.
+     * Once none of the open bins fits another item, the remaining items go
+     * into new bins, two at a time if two fit together, at a cost linear in
+     * their number.
+     */
+    void fit_many(std::uint32_t val, std::uint32_t count) {
+        for (; count > 0u; --count) {
+            const auto idx = query(val);
+            if (idx >= bins_.size()) {
+                break;
+            }
+            bins_[idx].second = val;
+            update(idx, c_);
         }
-    }
 
-    void update(std::uint32_t idx, std::uint32_t x, std::uint32_t val,
-                std::uint32_t left, std::uint32_t right) {
-        if (left == right) {
-            st_[idx] += val;
+        if (!count) {
             return;
         }
 
-        const auto m = mid(left, right);
-
-        if (x <= m) {
-            update(2u * idx, x, val, left, m);
+        const auto first = static_cast<std::uint32_t>(bins_.size());
+        const auto paired = 2u * val <= c_;
+        if (paired) {
+            bins_.insert(bins_.end(), count / 2u, std::make_pair(val, val));
+            if (count % 2u) {
+                bins_.push_back(std::make_pair(val, 0u));
+            }
         } else {
-            update(2u * idx + 1u, x, val, m + 1u, right);
+            bins_.insert(bins_.end(), count, std::make_pair(val, 0u));
         }
+        const auto last = static_cast<std::uint32_t>(bins_.size());
 
-        st_[idx] = std::min(st_[2u * idx], st_[2u * idx + 1u]);
-    }
-
-    void fit(std::uint32_t val) {
-        const auto idx = query(1u, val, 1u, n_);
-        if (idx > bins_.size()) {
-            bins_.push_back(std::make_pair(val, 0u));
-            update(1u, idx, val, 1u, n_);
-        } else {
-            bins_[idx - 1u].second = val;
-            update(1u, idx, c_ - bins_[idx - 1u].first, 1u, n_);
+        std::fill(st_.begin() + leaves_ + first, st_.begin() + leaves_ + last,
+                  paired ? c_ : val);
+        if (paired && count % 2u) {
+            st_[leaves_ + last - 1u] = val;
         }
+        repair(first, last);
     }
 
     std::vector<std::pair<std::uint32_t, std::uint32_t>> &bins() {
@@ -72,10 +77,53 @@ class Fitter {
     }
 
  private:
-    std::uint32_t n_;
+    std::uint32_t leaves_;
     std::uint32_t c_;
     std::vector<std::uint32_t> st_;
     std::vector<std::pair<std::uint32_t, std::uint32_t>> bins_;
+
+    /*
+     * Returns the least power of two not less than n.
+     */
+    static std::uint32_t leaves(std::uint32_t n) {
+        auto result = 1u;
+        while (result < n) {
+            result <<= 1u;
+        }
+        return result;
+    }
+    /*
+     * Returns the index of the first bin with room for an item of size val.
+     */
+    std::uint32_t query(std::uint32_t val) const {
+        auto idx = 1u;
+        while (idx < leaves_) {
+            idx = 2u * idx + (st_[2u * idx] > c_ - val);
+        }
+        return idx - leaves_;
+    }
+    /*
+     * Sets the load of bin x to val.
+     */
+    void update(std::uint32_t x, std::uint32_t val) {
+        auto idx = leaves_ + x;
+        st_[idx] = val;
+        for (idx >>= 1u; idx > 0u; idx >>= 1u) {
+            st_[idx] = std::min(st_[2u * idx], st_[2u * idx + 1u]);
+        }
+    }
+    /*
+     * Recomputes the minima above the bins from first to last, exclusive.
+     */
+    void repair(std::uint32_t first, std::uint32_t last) {
+        auto lo = leaves_ + first;
+        auto hi = leaves_ + last - 1u;
+        for (lo >>= 1u, hi >>= 1u; lo > 0u; lo >>= 1u, hi >>= 1u) {
+            for (auto idx = lo; idx <= hi; ++idx) {
+                st_[idx] = std::min(st_[2u * idx], st_[2u * idx + 1u]);
+            }
+        }
+    }
 };
 
 /*
@@ -88,22 +136,120 @@ constexpr std::uint32_t div3u(std::uint32_t n) {
 /*
  * Step function used by bound class L_*^(p), which is part of `l3star`.
  */
-constexpr std::uint32_t u(std::uint32_t k, std::uint32_t x, std::uint32_t c) {
-    const auto quot = x * (k + 1u) / c;
-    const auto rem = x * (k + 1u) % c;
-    return rem == 0u ? x * k : quot * c;
+constexpr std::uint64_t u(std::uint32_t k, std::uint32_t x, std::uint32_t c) {
+    const auto quot = std::uint64_t{x} * (k + 1u) / c;
+    const auto rem = std::uint64_t{x} * (k + 1u) % c;
+    return rem == 0u ? std::uint64_t{x} * k : quot * c;
+}
+
+/*
+ * The number of values of the parameter k evaluated together by `lstar`.
+ */
+constexpr std::uint32_t lstar_lanes = 16u;
+
+/*
+ * Sets values[j] to u(first + j, x, c) for j below lanes. Only the first
+ * value takes a division, the others step x * (k + 1) forward by x.
+ */
+inline void u_lanes(std::uint32_t first, std::uint32_t lanes, std::uint32_t x,
+                    std::uint32_t c,
+                    std::array<std::uint64_t, lstar_lanes> *values) {
+    auto quot = std::uint64_t{x} * (first + 1u) / c;
+    auto rem = static_cast<std::uint32_t>(std::uint64_t{x} * (first + 1u) % c);
+    for (auto j = 0u; j < lanes; ++j) {
+        (*values)[j] = rem == 0u ? std::uint64_t{x} * (first + j) : quot * c;
+        // x is at most c, so the remainder wraps at most once
+        rem += x;
+        if (rem >= c) {
+            rem -= c;
+            ++quot;
+        }
+    }
+}
+
+/*
+ * Computes the greatest of the bounds L_*^(k) for k from first to last, at
+ * most `lstar_lanes` apart, for the `ItemCount` range from begin to end,
+ * sorted by increasing size. The items before right are those not larger
+ * than half the bin capacity. A single sweep over the items advances the
+ * bounds for all k, until each of them has stopped increasing.
+ */
+template <class InputIt>
+std::uint32_t lstar(InputIt begin, InputIt right, InputIt end,
+                    std::uint32_t bin_capacity, std::uint32_t first,
+                    std::uint32_t last) {
+    const auto lanes = last - first + 1u;
+    std::array<std::uint64_t, lstar_lanes> capacity{};
+    std::array<std::uint64_t, lstar_lanes> total{};
+    std::array<std::uint64_t, lstar_lanes> maximum{};
+    std::array<std::uint64_t, lstar_lanes> values;
+    std::array<bool, lstar_lanes> active{};
+
+    const auto ceiling = [&capacity, &total](std::uint32_t j) {
+        return total[j] ? 1u + (total[j] - 1u) / capacity[j] : total[j];
+    };
+
+    for (auto j = 0u; j < lanes; ++j) {
+        capacity[j] = std::uint64_t{bin_capacity} * (first + j);
+    }
+    for (auto it = begin; it != end; ++it) {
+        u_lanes(first, lanes, it->size, bin_capacity, &values);
+        for (auto j = 0u; j < lanes; ++j) {
+            total[j] += it->count * values[j];
+        }
+    }
+    for (auto j = 0u; j < lanes; ++j) {
+        maximum[j] = ceiling(j);
+        active[j] = true;
+    }
+
+    auto rit = std::make_reverse_iterator(end);
+    auto prev = begin;
+    auto remaining = lanes;
+    for (auto it = begin; it != right && remaining; ++it) {
+        for (; rit->size > bin_capacity - it->size; ++rit) {
+            u_lanes(first, lanes, rit->size, bin_capacity, &values);
+            for (auto j = 0u; j < lanes; ++j) {
+                total[j] += rit->count * (capacity[j] - values[j]);
+            }
+        }
+        if (it != begin) {
+            u_lanes(first, lanes, prev->size, bin_capacity, &values);
+            for (auto j = 0u; j < lanes; ++j) {
+                total[j] -= prev->count * values[j];
+            }
+            ++prev;
+        }
+        for (auto j = 0u; j < lanes; ++j) {
+            if (!active[j]) {
+                continue;
+            }
+            const auto current = ceiling(j);
+            if (it != begin && current < maximum[j]) {
+                active[j] = false;
+                --remaining;
+            } else {
+                maximum[j] = std::max(current, maximum[j]);
+            }
+        }
+    }
+
+    return static_cast<std::uint32_t>(
+        *std::max_element(maximum.cbegin(), maximum.cbegin() + lanes));
 }
 
 /*
  * Computes the bound L_3^* for a problem defined by the `ItemCount` range
  * from begin to end, the amount slack, the bin count and their capacity.
  * The iterations parameter corresponds to the constant p in bound
- * class L_*^(p).
+ * class L_*^(p). If a pool is given, the bounds of that class are evaluated
+ * on its threads, `lstar_lanes` values of k at a time.
  */
-template <std::uint32_t iterations = 20u, class InputIt>
-inline static std::uint32_t l3star(InputIt begin, InputIt end,
-                                   std::uint32_t slack, std::uint32_t bin_count,
-                                   std::uint32_t bin_capacity) {
+template <class InputIt>
+inline static std::uint32_t
+l3star(InputIt begin, InputIt end, std::uint32_t slack,
+       std::uint32_t bin_count, std::uint32_t bin_capacity,
+       std::uint32_t iterations = 20u, ThreadPool *pool = nullptr) {
     if (bin_count <= 1u) {
         return 0u;
     }
@@ -124,16 +270,16 @@ inline static std::uint32_t l3star(InputIt begin, InputIt end,
         for (auto rbegin = std::make_reverse_iterator(end),
                   rend = std::make_reverse_iterator(begin);
              rbegin != rend; ++rbegin) {
-            for (auto i = 0u; i < rbegin->count; ++i) {
-                const auto d = bin_capacity - rbegin->size;
-                if (s >= d) {
-                    if (++x == bin_count) {
-                        return 0u;
-                    }
-                    s -= d;
-                }
-                f.fit(rbegin->size);
+            // items of this size take the slack they need while it lasts
+            const auto d = bin_capacity - rbegin->size;
+            const auto taken =
+                d ? std::min(rbegin->count, s / d) : rbegin->count;
+            if (taken >= bin_count - x) {
+                return 0u;
             }
+            x += taken;
+            s -= taken * d;
+            f.fit_many(rbegin->size, rbegin->count);
         }
 
         auto &bins = f.bins();
@@ -180,46 +326,22 @@ inline static std::uint32_t l3star(InputIt begin, InputIt end,
 
     auto kmax = std::uint32_t{};
 
-    for (auto k = 2u; k <= iterations; ++k) {
-        auto total = std::accumulate(
-            begin, end, std::uint32_t{},
-            [k, bin_capacity](auto lhs, const auto &rhs) {
-                return lhs + rhs.count * u(k, rhs.size, bin_capacity);
-            });
-        auto maximum = total ? 1u + ((total - 1u) / (bin_capacity * k)) : total;
-
-        auto rit = std::make_reverse_iterator(end);
-        auto it = begin;
-        auto prev = begin;
-        if (it != right) {
-            while (rit->size > bin_capacity - it->size) {
-                total += rit->count *
-                         (bin_capacity * k - u(k, rit->size, bin_capacity));
-                ++rit;
-            }
-            const auto ceiling =
-                total ? 1u + (total - 1u) / (bin_capacity * k) : total;
-            maximum = std::max(ceiling, maximum);
-            ++it;
-        }
-        for (; it != right; ++it) {
-            while (rit->size > bin_capacity - it->size) {
-                total += rit->count *
-                         (bin_capacity * k - u(k, rit->size, bin_capacity));
-                ++rit;
-            }
-
-            total -= prev->count * u(k, prev->size, bin_capacity);
-            ++prev;
-
-            const auto ceiling =
-                total ? 1u + (total - 1u) / (bin_capacity * k) : total;
-            if (ceiling < maximum) {
-                break;
+    if (iterations >= 2u) {
+        const auto groups = (iterations - 2u) / lstar_lanes + 1u;
+        std::vector<std::uint32_t> maxima(groups);
+        const auto group = [&](std::uint32_t g) {
+            const auto first = 2u + g * lstar_lanes;
+            const auto last = std::min(first + lstar_lanes - 1u, iterations);
+            maxima[g] = lstar(begin, right, end, bin_capacity, first, last);
+        };
+        if (pool) {
+            pool->parallel_for(groups, group);
+        } else {
+            for (auto g = 0u; g < groups; ++g) {
+                group(g);
             }
-            maximum = ceiling;
         }
-        kmax = std::max(maximum, kmax);
+        kmax = *std::max_element(maxima.cbegin(), maxima.cend());
     }
 
     auto total = std::accumulate(
@@ -250,6 +372,88 @@ inline static std::uint32_t l3star(InputIt begin, InputIt end,
                               : std::max(minsplit, maxval - bin_count);
 }
 
+/*
+ * A lower bound on the number of bins needed to pack the items of a problem
+ * without fragmenting them, given its `ItemCount`s and the bin capacity. A
+ * packing with k cuts can be turned into one without fragments and at most
+ * k more bins, by moving every fragmented item to a bin of its own, so such
+ * a bound also bounds the number of cuts, see `cuts_for_bins`.
+ */
+typedef std::function<std::uint32_t(const std::vector<ItemCount> &,
+                                    std::uint32_t)>
+    BinBound;
+
+/*
+ * Converts bins, a lower bound on the number of bins needed without
+ * fragmentation, into a lower bound on the cuts needed with bin_count bins.
+ */
+constexpr std::uint32_t cuts_for_bins(std::uint32_t bins,
+                                      std::uint32_t bin_count) {
+    return bins > bin_count ? bins - bin_count : 0u;
+}
+
+/*
+ * Dual-feasible function f_CCM,1 of Carlier, Clautiaux and Moukrim, with
+ * parameter lambda between 1 and half the bin capacity c.
+ */
+constexpr std::uint64_t ccm(std::uint32_t lambda, std::uint32_t x,
+                            std::uint32_t c) {
+    return x > c - x    ? 2u * (std::uint64_t{c / lambda} - (c - x) / lambda)
+           : x == c - x ? std::uint64_t{c / lambda}
+                        : 2u * std::uint64_t{x / lambda};
+}
+
+/*
+ * Computes a lower bound on the number of bins of capacity bin_capacity
+ * needed to pack the `ItemCount` range from begin to end without
+ * fragmentation. It is the greatest bound given by `ccm` over at most
+ * parameters values of lambda, spread evenly over the item sizes not larger
+ * than half the bin capacity. If a pool is given, the values of lambda are
+ * tried on its threads.
+ */
+template <class InputIt>
+std::uint32_t ccm_bound(InputIt begin, InputIt end, std::uint32_t bin_capacity,
+                        std::uint32_t parameters = 64u,
+                        ThreadPool *pool = nullptr) {
+    std::vector<std::uint32_t> lambdas;
+    for (auto it = begin; it != end; ++it) {
+        if (it->count && it->size <= bin_capacity - it->size) {
+            lambdas.push_back(it->size);
+        }
+    }
+    if (lambdas.size() > parameters) {
+        const auto n = static_cast<std::uint64_t>(lambdas.size());
+        for (auto i = 0u; i < parameters; ++i) {
+            lambdas[i] = lambdas[i * n / parameters];
+        }
+        lambdas.resize(parameters);
+    }
+    if (lambdas.empty()) {
+        return 0u;
+    }
+
+    std::vector<std::uint32_t> bounds(lambdas.size());
+    const auto evaluate = [&](std::uint32_t i) {
+        const auto lambda = lambdas[i];
+        auto total = std::uint64_t{};
+        for (auto it = begin; it != end; ++it) {
+            total += it->count * ccm(lambda, it->size, bin_capacity);
+        }
+        const auto full = ccm(lambda, bin_capacity, bin_capacity);
+        bounds[i] = static_cast<std::uint32_t>(
+            total ? 1u + (total - 1u) / full : total);
+    };
+    if (pool) {
+        pool->parallel_for(bounds.size(), evaluate);
+    } else {
+        for (auto i = 0u; i < bounds.size(); ++i) {
+            evaluate(i);
+        }
+    }
+
+    return *std::max_element(bounds.cbegin(), bounds.cend());
+}
+
 } // namespace optimizer
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef PARAMETERS_H_
+#define PARAMETERS_H_
+
+#include <cstdint>
+
+namespace optimizer {
+
+/*
+ * The parameters of the grouping genetic algorithm, set at run time. The
+ * defaults are those of the original algorithm.
+ */
+struct Parameters {
+    // the size of the population
+    std::uint32_t np = 100u;
+    // the number of individuals selected for crossover, half of them good
+    std::uint32_t nc = 20u;
+    // the number of individuals selected for mutation
+    std::uint32_t nm = 83u;
+    // the size of the elite set
+    std::uint32_t ne = 10u;
+    // the number of generations an elite individual is cloned for
+    std::uint32_t ls = 10u;
+    // the maximum number of generations
+    std::uint32_t ng = 500u;
+    // the number of generations without improvement after which to stop
+    std::uint32_t dl = 100u;
+    // the aggressiveness of mutation, for mutants and for clones
+    double k1 = 1.3;
+    double k2 = 4.0;
+    // the number of generations between migrations among islands
+    std::uint32_t mi = 10u;
+    // the number of individuals migrating from each island
+    std::uint32_t ni = 2u;
+    // whether children and clones duplicating an individual are rejected
+    bool unique = true;
+
+    /*
+     * Determines if the parameters describe a population the algorithm can
+     * work on. Crossover needs at least two pairs, so that a good individual
+     * drawn as its own random partner can be swapped with another, and as
+     * many individuals outside the elite set as it selects, since the
+     * children of the random ones replace others among those not selected.
+     */
+    bool valid() const {
+        return nc >= 4u && nc % 2u == 0u && ne <= nm && nm <= np &&
+               ne < np && nc <= np - ne && mi > 0u && ni < np - ne;
+    }
+};
+
+} // namespace optimizer
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef POPULATION_H_
+#define POPULATION_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "environment.h"
+#include "problem.h"
+#include "solution.h"
+#include "thread_pool.h"
+
+namespace optimizer {
+
+/*
+ * Fills a population with initial solutions of a `Problem`, generated on the
+ * threads of pool. Individual i is generated on the i-th of as many
+ * sub-streams as the population has entries, split off the environment of the
+ * problem, so the population does not depend on the number of threads.
+ * Parameter `do_b3` is passed on to `Problem::generate_individual`.
+ *
+ * Generation stops as soon as an individual reaches the lower bound, in which
+ * case the entries after it may be null. Returns the index of the first such
+ * individual, or the size of the population if there is none.
+ */
+template <bool do_b3 = true>
+std::uint32_t generate_population(const Problem &problem, ThreadPool *pool,
+                                  Population *population) {
+    const auto np = static_cast<std::uint32_t>(population->size());
+    const auto seed = problem.env()->seed();
+    const auto first = problem.env()->split(np);
+
+    const auto k = std::min<std::uint32_t>(pool->size(), np);
+    std::atomic<std::uint32_t> optimal{np};
+
+    pool->parallel_for(k, [&](std::uint32_t c) {
+        Environment env(seed, first + c);
+        auto context = problem.context(&env);
+        // indices below the first optimal one found so far are still
+        // generated, so the index returned does not depend on thread timing
+        for (auto i = c; i < optimal.load(); i += k) {
+            env.reseed(seed, first + i);
+            context.restart();
+            (*population)[i] = problem.generate_individual<do_b3>(&context);
+            if (problem.bin_count() - (*population)[i]->size() ==
+                problem.lower_bound()) {
+                auto expected = optimal.load();
+                while (i < expected &&
+                       !optimal.compare_exchange_weak(expected, i)) {
+                }
+            }
+        }
+    });
+
+    return optimal.load();
+}
+
+} // namespace optimizer
+
+#endif
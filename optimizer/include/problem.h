@@ -4,14 +4,20 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstddef>
+#include <iterator>
 #include <memory>
 #include <numeric>
+#include <tuple>
 #include <vector>
 
+#include "context.h"
 #include "environment.h"
 #include "lower_bound.h"
 #include "replacers.h"
+#include "thread_pool.h"
 #include "threesum.h"
 #include "util.h"
 
@@ -20,11 +26,12 @@ namespace optimizer {
 /*
  * A `Problem` object contains the specifications of a problem which is
  * guaranteed to be reduced by E1 and E2 upon creation. Also has remaining
- * optimiztion algorithms.
+ * optimiztion algorithms. A `Problem` is not changed by the algorithms, which
+ * keep their mutable state in a `Context`.
  */
 class Problem {
-    mutable Environment *env_;
-    mutable std::vector<ItemCount> items_;
+    Environment *env_;
+    std::vector<ItemCount> items_;
     std::uint32_t bin_count_;
     std::uint32_t bin_capacity_;
     std::uint32_t item_count_;
@@ -33,128 +40,247 @@ class Problem {
     std::uint32_t original_slack_;
     std::uint32_t unique_size_count_;
     std::uint32_t slack_;
-    std::uint32_t lower_bound_;
+    std::atomic<std::uint32_t> lower_bound_;
     std::uint32_t optimal1_;
     std::uint32_t optimal21_;
     std::vector<std::tuple<std::uint32_t, std::uint32_t, std::uint32_t>>
         optimal22_;
     std::vector<Partition> initial_3_partitions_;
+    ThreeSum three_sum_;
+    std::array<std::uint32_t, 2u> partition_ends_;
+    WeightTree partition_weights_;
+    bool lazy_partitions_;
+    bool sample_items_;
     bool solved_;
 
     /*
-     * Determines if a partition is allowed with respect to the currently
-     * available items and slack. The argument p_one points to the `ItemCount`
-     * entry for size 1. If the partition is allowed, its items are copied
-     * to the out iterator and the number of items copied is returned.
+     * Performs reduction E2.2 on the threads of pool, with the same outcome
+     * as the two-pointer sweep of the constructor. The sizes larger than half
+     * the bin capacity are split into chunks, in which each size looks up its
+     * complement by binary search. The reductions of the chunks are recorded
+     * in order, followed by the pairs of sizes of exactly half the capacity.
      */
-    template <class OutputIt>
-    static std::uint32_t
-    allowed_partition(const Partition &partition, std::uint32_t *slack,
-                      const ItemCount *p_one, OutputIt out) {
-        auto idx = 0u;
-        const auto &p_items = partition.items();
+    void pair_in_parallel(ThreadPool *pool) {
+        const auto c = bin_capacity_;
+        const auto half = std::partition_point(
+            items_.begin(), items_.end(),
+            [c](const auto &v) { return v.size > c - v.size; });
+        const auto h = static_cast<std::uint64_t>(half - items_.begin());
+        const auto k = static_cast<std::uint32_t>(
+            std::min<std::uint64_t>(pool->size(), h));
+
+        std::vector<decltype(optimal22_)> found(k);
+        pool->parallel_for(k, [&](std::uint32_t i) {
+            const auto first = items_.begin() + h * i / k;
+            const auto last = items_.begin() + h * (i + 1u) / k;
+            for (auto l = first; l != last; ++l) {
+                const auto r = std::lower_bound(
+                    half, items_.end(), c - l->size,
+                    [](const auto &v, std::uint32_t size) {
+                        return v.size > size;
+                    });
+                if (r != items_.end() && r->size == c - l->size) {
+                    const auto min = std::min(l->count, r->count);
+                    l->count -= min;
+                    r->count -= min;
+                    found[i].emplace_back(min, l->size, r->size);
+                }
+            }
+        });
 
-        if (p_items[0]->count == 0u) {
-            return 0u;
+        for (const auto &chunk : found) {
+            for (const auto &reduction : chunk) {
+                optimal22_.push_back(reduction);
+                bin_count_ -= std::get<0>(reduction);
+                item_count_ -= 2u * std::get<0>(reduction);
+            }
         }
-        --p_items[0]->count;
-        ++idx;
-        auto size = p_items[0]->size;
 
-        auto used_slack = false;
-
-        if (p_items[1] == p_one) {
-            if (p_items[1]->count > 0u) {
-                --p_items[1]->count;
-                ++idx;
-                size += p_items[1]->size;
-            } else if (*slack) {
-                --*slack;
-                used_slack = true;
-            } else {
-                ++p_items[0]->count;
-                return 0u;
+        if (half != items_.end() && half->size == c - half->size) {
+            optimal22_.emplace_back(half->count / 2u, half->size, half->size);
+            bin_count_ -= half->count / 2u;
+            item_count_ -= half->count - half->count % 2u;
+            half->count = half->count % 2u;
+        }
+    }
+    /*
+     * Determines how much of a partition fits the currently available items
+     * and slack. The counts of the items are looked up in the array counts,
+     * which mirrors the items of the `Problem`. The argument one is the index
+     * of the item of size 1, of which missing parts may be made up by slack.
+     * Returns the number of parts taken from items, which are the first ones,
+     * or 0 if the partition does not fit.
+     */
+    static std::uint32_t fit_partition(const Partition::Items &p_items,
+                                       std::uint32_t slack, std::uint32_t one,
+                                       const ItemCount *counts) {
+        auto taken = 0u;
+
+        for (auto k = 0u; k < 3u; ++k) {
+            auto count = counts[p_items[k]].count;
+            for (auto j = 0u; j < taken; ++j) {
+                count -= p_items[j] == p_items[k] ? 1u : 0u;
             }
-        } else {
-            if (p_items[1]->count > 0u) {
-                --p_items[1]->count;
-                ++idx;
-                size += p_items[1]->size;
+            if (count > 0u) {
+                ++taken;
+            } else if (k > 0u && p_items[k] == one && slack > 0u) {
+                --slack;
             } else {
-                ++p_items[0]->count;
                 return 0u;
             }
         }
 
-        if (p_items[2] == p_one) {
-            if (p_items[2]->count > 0u) {
-                --p_items[2]->count;
-                ++idx;
-                size += p_items[2]->size;
-            } else if (*slack) {
-                --*slack;
-            } else {
-                if (used_slack) {
-                    ++*slack;
-                } else {
-                    ++p_items[1]->count;
-                }
-                ++p_items[0]->count;
-                return 0u;
+        return taken;
+    }
+
+    /*
+     * Determines if a partition is allowed with respect to the currently
+     * available items and slack, as by fit_partition. If the partition is
+     * allowed, its items and slack are taken, the indices of its items are
+     * copied to the out iterator and the number of items copied is returned.
+     */
+    template <class OutputIt>
+    static std::uint32_t
+    allowed_partition(const Partition::Items &p_items, std::uint32_t *slack,
+                      std::uint32_t one, ItemCount *counts, OutputIt out) {
+        const auto n = fit_partition(p_items, *slack, one, counts);
+
+        if (n) {
+            for (auto k = 0u; k < n; ++k) {
+                --counts[p_items[k]].count;
             }
-        } else {
-            if (p_items[2]->count > 0u) {
-                --p_items[2]->count;
-                ++idx;
-                size += p_items[2]->size;
+            *slack -= 3u - n;
+            std::copy_n(p_items.cbegin(), n, out);
+        }
+
+        return n;
+    }
+
+    /*
+     * Takes partition for solution if allowed, as by allowed_partition, and
+     * appends a block for it. Returns the number of bins of the block, or 0 if
+     * the partition is not allowed.
+     */
+    std::uint32_t pack_partition(Context *context,
+                                 const Partition::Items &partition,
+                                 std::uint32_t *slack,
+                                 std::uint32_t *item_count,
+                                 Solution *solution) const {
+        auto &items = solution->items();
+        const auto n =
+            allowed_partition(partition, slack, items_.size() - 1u,
+                              context->items().data(),
+                              std::back_inserter(items));
+        if (!n) {
+            return 0u;
+        }
+        *item_count -= n;
+        const auto size = std::accumulate(
+            partition.cbegin(), partition.cbegin() + n,
+            std::uint32_t{}, [this](auto lhs, std::uint32_t rhs) {
+                return lhs += items_[rhs].size;
+            });
+        const auto bin_count = size > bin_capacity_ ? 2u : 1u;
+        solution->blocks().emplace_back(items.size() - n, items.size(),
+                                        bin_count, size, bin_capacity_);
+        solution->blocks().back().rekey(items.data());
+        return bin_count;
+    }
+
+    /*
+     * The core of algorithm B3. Produces blocks from 3-partitions drawn at
+     * random, with state kept by the context, until none of them fits. The
+     * slack argument is an in/out parameter for the amount of slack available.
+     * The item_count argument is an in/out parameter for the number of
+     * unpacked items. Item counts are taken from the context, while the
+     * solution argument points to the solution which should be processed. It
+     * returns the number of bins used.
+     */
+    std::uint32_t find_packing(Context *context, std::uint32_t *slack,
+                               std::uint32_t *item_count,
+                               Solution *solution) const {
+        return lazy_partitions_
+                   ? find_packing_lazily(context, slack, item_count, solution)
+                   : find_packing_in_table(context, slack, item_count,
+                                           solution);
+    }
+
+    /*
+     * B3 over the table of all 3-partitions, whose indices are in the order
+     * of the context. A partition which does not fit is moved out of the range
+     * drawn from.
+     */
+    std::uint32_t find_packing_in_table(Context *context, std::uint32_t *slack,
+                                        std::uint32_t *item_count,
+                                        Solution *solution) const {
+        auto &order = context->partitions();
+        auto s = static_cast<std::uint32_t>(order.size());
+        auto bins_used = std::uint32_t{};
+
+        while (s > 0u) {
+            const auto idx = bounded_rand(s, *context->env()->rng());
+            const auto &partition = initial_3_partitions_[order[idx]];
+            const auto bins = pack_partition(context, partition.items(), slack,
+                                             item_count, solution);
+            if (bins) {
+                bins_used += bins;
             } else {
-                if (used_slack) {
-                    ++*slack;
-                } else {
-                    ++p_items[1]->count;
-                }
-                ++p_items[0]->count;
-                return 0u;
+                std::swap(order[idx], order[--s]);
             }
         }
-        std::copy_n(p_items.cbegin(), idx, out);
-        return idx;
+
+        return bins_used;
     }
 
     /*
-     * The core of algorithm B3. Produces blocks from a set of partitions in the
-     * range from begin to end. The slack argument is an in/out parameter for
-     * the amount of slack available. The item_count argument is an in/out
-     * parameter for the number of unpacked items. Argument p_one is a pointer
-     * to the `ItemCount` object for item size 1, while the solution argument
-     * points to the solution which should be processed. It returns the number
-     * of bins used.
+     * B3 without a table of 3-partitions. The weights of the context start as
+     * the numbers of partitions for one and two bins by last part, so a last
+     * part drawn by weight and one of its partitions drawn by offset into the
+     * weight give each partition the same chance. Weights only bound the
+     * numbers of partitions which fit, as these only go down, so a draw past
+     * them lowers the weight to the number which fit and is repeated.
      */
-    template <class RandomIt>
-    std::uint32_t find_packing(RandomIt begin, RandomIt end,
-                               std::uint32_t *slack, std::uint32_t *item_count,
-                               ItemCount *p_one, Solution *solution) const {
-        std::uint32_t s = std::distance(begin, end);
+    std::uint32_t find_packing_lazily(Context *context, std::uint32_t *slack,
+                                      std::uint32_t *item_count,
+                                      Solution *solution) const {
+        auto &weights = context->weights();
+        auto &rng = *context->env()->rng();
+        const auto counts = context->items().data();
+        const auto one = static_cast<std::uint32_t>(items_.size() - 1u);
         auto bins_used = std::uint32_t{};
 
-        while (s > 0u) {
-            const auto idx = bounded_rand(s, *env_->rng());
-            const auto n =
-                allowed_partition(begin[idx], slack, p_one,
-                                  std::back_inserter(solution->items()));
-            if (n) {
-                *item_count -= n;
-                const auto size = std::accumulate(
-                    begin[idx].items().cbegin(),
-                    begin[idx].items().cbegin() + n, std::uint32_t{},
-                    [](auto lhs, const auto &rhs) { return lhs += rhs->size; });
-                const auto bin_count = size > bin_capacity_ ? 2u : 1u;
-                bins_used += bin_count;
-                solution->blocks().emplace_back(solution->items().end() -= n,
-                                                solution->items().end(),
-                                                bin_count, size);
+        weights = partition_weights_;
+        for (auto total = weights.total(); total > 0u;
+             total = weights.total()) {
+            auto k = bounded_rand64(total, rng);
+            const auto i = weights.find(&k);
+            const auto two = i >= partition_ends_[0];
+            const auto e = i - (two ? partition_ends_[0] : 0u);
+            const auto r = (two ? 2u : 1u) * bin_capacity_;
+
+            // finds the k-th partition which fits, or counts them all, of
+            // which there are none without the last part
+            auto fitting = std::uint64_t{};
+            auto chosen = Partition::Items{{e, e, e}};
+            if (counts[e].count || (e == one && *slack)) {
+                three_sum_.pairs(
+                    r, e, three_sum_.first(r, e),
+                    [&](std::uint32_t p_a, std::uint32_t p_b) {
+                        const auto partition = Partition::Items{{p_a, p_b, e}};
+                        if (fit_partition(partition, *slack, one, counts) &&
+                            fitting++ == k) {
+                            chosen = partition;
+                            return true;
+                        }
+                        return false;
+                    });
+            }
+
+            if (fitting > k) {
+                bins_used += pack_partition(context, chosen, slack, item_count,
+                                            solution);
             } else {
-                std::swap(begin[idx], begin[--s]);
+                weights.lower(i, weights.weight(i) - fitting);
             }
         }
 
@@ -162,64 +288,177 @@ class Problem {
     }
 
     /*
-     * The core of algorithm G^+. Finds blocks for a `Problem` given a randomly
-     * permuted range of items from begin to end and the amount of slack
-     * available. Found blocks are written to the out iterator.
+     * The core of algorithm G^+. Finds blocks for the items of solution from
+     * offset begin onwards, which are randomly permuted, given the amount of
+     * slack available. Found blocks are appended to the solution.
      */
-    template <class InIt, class OutIt>
-    static void next_fit_fragmentation(const Problem &problem, InIt begin,
-                                       InIt end, std::uint32_t slack,
-                                       OutIt out) {
+    static void next_fit_fragmentation(const Problem &problem,
+                                       Solution *solution, std::uint32_t begin,
+                                       std::uint32_t slack) {
+        auto &items = solution->items();
+        const auto end = static_cast<std::uint32_t>(items.size());
+
         if (begin == end) {
             return;
         }
 
-        auto current_block = Solution::Block(begin, begin, 1u, 0u);
+        const auto c = problem.bin_capacity();
+        auto current_block = Solution::Block(begin, begin, 1u, 0u, c);
         auto has_slack = false;
 
         for (; begin != end; ++begin) {
-            if (*begin) {
-                const auto s = current_block.slack(problem.bin_capacity());
-                if ((*begin)->size > s && has_slack * slack >= s) {
+            auto size = 0u;
+            if (items[begin] != dummy_item) {
+                size = problem.items_[items[begin]].size;
+                const auto s = current_block.slack(c);
+                if (size > s && has_slack * slack >= s) {
                     has_slack = false;
                     slack -= s;
-                    current_block.complete();
-                    *out++ = std::move(current_block);
-                    current_block = Solution::Block(begin, begin, 1u, 0u);
+                    current_block.complete(items.data(), c);
+                    solution->blocks().push_back(current_block);
+                    current_block = Solution::Block(begin, begin, 1u, 0u, c);
                 }
             } else {
                 has_slack = true;
             }
-            current_block.put(*begin, problem.bin_capacity());
+            current_block.put(size, c);
         }
-        slack -= current_block.slack(problem.bin_capacity());
-        current_block.complete();
-        *out++ = std::move(current_block);
+        slack -= current_block.slack(c);
+        current_block.complete(items.data(), c);
+        solution->blocks().push_back(current_block);
         if (slack) {
-            assert(slack % problem.bin_capacity() == 0u);
-            std::fill_n(out, slack / problem.bin_capacity(),
-                        Solution::Block(end, end, 1u, 0u));
+            assert(slack % c == 0u);
+            std::fill_n(std::back_inserter(solution->blocks()), slack / c,
+                        Solution::Block(end, end, 1u, 0u, c));
         }
     }
 
     Problem(const Problem &) = delete;
     Problem &operator=(const Problem &) = delete;
     template <bool use_b3>
-    friend std::unique_ptr<Solution> gene_level_crossover(Problem *problem,
-                                                          const Solution &l,
-                                                          const Solution &r);
-    template <intmax_t Num, intmax_t Dom, bool use_b3>
-    friend void adaptive_mutation(Problem *problem, Solution *mutant);
+    friend void gene_level_crossover(const Problem *problem, Context *context,
+                                     const Solution &l, const Solution &r,
+                                     Solution *result);
+    template <bool use_b3>
+    friend void adaptive_mutation(const Problem *problem, Context *context,
+                                  double k, Solution *mutant);
 
  public:
+    /*
+     * Problems with more 3-partitions than this do not keep a table of them,
+     * but find them on demand.
+     */
+    static constexpr std::uint64_t partition_budget = 1u << 22u;
+    /*
+     * Problems with a larger bin capacity read from a single pass range do
+     * not count their item sizes with a histogram.
+     */
+    static constexpr std::uint32_t histogram_limit = 1u << 24u;
+    /*
+     * Problems with fewer items, or fewer distinct sizes, than this are
+     * reduced serially, even if given a pool.
+     */
+    static constexpr std::uint32_t parallel_threshold = 1u << 16u;
+    /*
+     * Counts the item sizes in the range from begin to end, as by `fcount`
+     * for the sizes sorted in decreasing order. A histogram over the sizes up
+     * to bin_capacity replaces sorting when it is cheaper, or when the range
+     * can only be read once.
+     */
+    template <class InputIt>
+    static std::vector<ItemCount>
+    count_sizes(InputIt begin, InputIt end, std::uint32_t bin_capacity,
+                ThreadPool *pool, std::input_iterator_tag) {
+        if (bin_capacity < histogram_limit) {
+            return hcount(begin, end, bin_capacity);
+        }
+        std::vector<std::uint32_t> sizes(begin, end);
+        return count_sizes(sizes.begin(), sizes.end(), bin_capacity, pool,
+                           std::random_access_iterator_tag{});
+    }
+    template <class ForwardIt>
+    static std::vector<ItemCount>
+    count_sizes(ForwardIt begin, ForwardIt end, std::uint32_t bin_capacity,
+                ThreadPool *, std::forward_iterator_tag) {
+        if (bin_capacity <= static_cast<std::uint64_t>(
+                                std::distance(begin, end))) {
+            return hcount(begin, end, bin_capacity);
+        }
+        std::vector<std::uint32_t> sizes(begin, end);
+        std::sort(sizes.begin(), sizes.end(),
+                  std::isgreater<std::uint32_t, std::uint32_t>);
+        return fcount(sizes.cbegin(), sizes.cend());
+    }
+    /*
+     * Given a pool and enough items, counts chunks of the range into
+     * histograms of their own on its threads, and adds them up.
+     */
+    template <class RandIt>
+    static std::vector<ItemCount>
+    count_sizes(RandIt begin, RandIt end, std::uint32_t bin_capacity,
+                ThreadPool *pool, std::random_access_iterator_tag) {
+        const auto n = static_cast<std::uint64_t>(end - begin);
+        const auto width = std::uint64_t{bin_capacity} + 1u;
+        if (!pool || n < parallel_threshold || 2u * width > n) {
+            return count_sizes(begin, end, bin_capacity, pool,
+                               std::forward_iterator_tag{});
+        }
+
+        const auto k = static_cast<std::uint32_t>(
+            std::min<std::uint64_t>(pool->size(), n / width));
+        std::vector<std::uint32_t> histograms(k * width);
+        pool->parallel_for(k, [&](std::uint32_t i) {
+            histogram_add(begin + n * i / k, begin + n * (i + 1u) / k,
+                          bin_capacity, histograms.data() + i * width);
+        });
+        pool->parallel_for(k, [&](std::uint32_t i) {
+            const auto first = width * i / k;
+            const auto last = width * (i + 1u) / k;
+            for (auto j = 1u; j < k; ++j) {
+                for (auto x = first; x < last; ++x) {
+                    histograms[x] += histograms[j * width + x];
+                }
+            }
+        });
+        return histogram_counts(histograms.data(), width);
+    }
+
+    /*
+     * Creates a `Problem` for the item sizes in the range from begin to end,
+     * which is read once if it is a single pass range, see `count_sizes`.
+     * The remaining parameters are those of the constructor taking counts.
+     */
     template <class InputIt>
     Problem(Environment *env, InputIt begin, InputIt end,
-            std::uint32_t bin_capacity, std::uint32_t bin_count = 0u)
-        : env_{env}, bin_capacity_{bin_capacity},
-          item_count_{static_cast<std::uint32_t>(std::distance(begin, end))},
-          original_item_count_{item_count_}, optimal1_{}, optimal21_{},
-          optimal22_{}, initial_3_partitions_{}, solved_{} {
-        const auto sum = std::accumulate(begin, end, std::uint32_t{});
+            std::uint32_t bin_capacity, std::uint32_t bin_count = 0u,
+            ThreadPool *pool = nullptr, std::uint32_t bound_iterations = 20u)
+        : Problem(env,
+                  count_sizes(begin, end, bin_capacity, pool,
+                              typename std::iterator_traits<
+                                  InputIt>::iterator_category{}),
+                  bin_capacity, bin_count, pool, bound_iterations) {}
+    /*
+     * Creates a `Problem` for the item sizes counted in sizes, which holds
+     * distinct sizes in decreasing order, like the result of `hcount`.
+     * The lower bound is the greater of `l3star` and `ccm_bound`. If a pool is
+     * given, the lower bound and the 3-partitions of large problems are
+     * computed on its threads. Parameter bound_iterations is passed on to
+     * `l3star`.
+     */
+    Problem(Environment *env, std::vector<ItemCount> sizes,
+            std::uint32_t bin_capacity, std::uint32_t bin_count = 0u,
+            ThreadPool *pool = nullptr, std::uint32_t bound_iterations = 20u)
+        : env_{env}, items_{std::move(sizes)}, bin_capacity_{bin_capacity},
+          item_count_{}, lower_bound_{}, optimal1_{}, optimal21_{},
+          optimal22_{}, initial_3_partitions_{}, three_sum_{},
+          partition_ends_{}, partition_weights_{}, lazy_partitions_{},
+          sample_items_{}, solved_{} {
+        auto sum = std::uint32_t{};
+        for (const auto &item : items_) {
+            item_count_ += item.count;
+            sum += item.count * item.size;
+        }
+        original_item_count_ = item_count_;
 
         assert(bin_capacity && "bad capacity");
         bin_count_ = 1u + (sum - 1u) / bin_capacity;
@@ -236,35 +475,30 @@ class Problem {
         original_bin_count_ = bin_count_;
         original_slack_ = slack_ = bin_count_ * bin_capacity - sum;
 
-        std::vector<std::uint32_t> item_sizes_copy;
-        item_sizes_copy.reserve(original_item_count_);
-
-        for (; begin != end; ++begin) {
-            if (*begin == bin_capacity) {
-                ++optimal1_;
-                continue;
-            }
-            if (*begin == bin_capacity - 1u && slack_ > 0u) {
-                ++optimal21_;
-                --slack_;
-                continue;
+        auto first = items_.begin();
+        if (first != items_.end() && first->size == bin_capacity) {
+            optimal1_ = first++->count;
+        }
+        if (first != items_.end() && first->size == bin_capacity - 1u) {
+            optimal21_ = std::min(first->count, slack_);
+            slack_ -= optimal21_;
+            first->count -= optimal21_;
+            if (!first->count) {
+                ++first;
             }
-            item_sizes_copy.push_back(*begin);
         }
+        items_.erase(items_.begin(), first);
 
         bin_count_ -= optimal1_ + optimal21_;
         item_count_ -= optimal1_ + optimal21_;
 
-        std::sort(item_sizes_copy.begin(), item_sizes_copy.end(),
-                  std::isgreater<std::uint32_t, std::uint32_t>);
-
-        items_ = fcount(item_sizes_copy.cbegin(), item_sizes_copy.cend());
-
-        if (items_.size()) {
+        if (pool && items_.size() >= parallel_threshold) {
+            pair_in_parallel(pool);
+        } else if (items_.size()) {
             auto l = items_.begin();
             auto r = --items_.end();
 
-            optimal22_.reserve(item_sizes_copy.size() / 2u);
+            optimal22_.reserve(item_count_ / 2u);
 
             while (l < r) {
                 auto together = l->size + r->size;
@@ -308,8 +542,15 @@ class Problem {
                              [](const auto &v) { return v.count > 0u; })));
         }
 
-        lower_bound_ = l3star(items_.crbegin(), items_.crend(), slack_,
-                              bin_count_, bin_capacity_);
+        auto bound = l3star(items_.crbegin(), items_.crend(), slack_,
+                            bin_count_, bin_capacity_, bound_iterations, pool);
+        if (!solved_) {
+            bound = std::max(
+                bound, cuts_for_bins(ccm_bound(items_.cbegin(), items_.cend(),
+                                               bin_capacity_, 64u, pool),
+                                     bin_count_));
+        }
+        lower_bound_.store(bound);
 
         unique_size_count_ = items_.size();
 
@@ -320,13 +561,42 @@ class Problem {
 
         items_.shrink_to_fit();
 
-        threesum(items_.begin(), items_.end(), &initial_3_partitions_, 1u,
-                 bin_capacity);
-        threesum(items_.begin(), items_.end(), &initial_3_partitions_, 2u,
-                 bin_capacity);
+        three_sum_ = ThreeSum(items_.cbegin(), items_.cend());
+        const auto w = static_cast<std::uint64_t>(items_.size());
+        if (w * (w + 1u) > partition_budget) {
+            partition_ends_ = {{three_sum_.ends(bin_capacity),
+                                three_sum_.ends(2u * bin_capacity)}};
+            std::vector<std::uint32_t> counts(partition_ends_[0] +
+                                              partition_ends_[1]);
+            three_sum_.count(bin_capacity, counts.data(), pool);
+            three_sum_.count(2u * bin_capacity,
+                             counts.data() + partition_ends_[0], pool);
+            // a table can not index more items than a `Partition` holds
+            lazy_partitions_ =
+                w >= Partition::max_items ||
+                std::accumulate(counts.cbegin(), counts.cend(),
+                                std::uint64_t{}) > partition_budget;
+            if (lazy_partitions_) {
+                partition_weights_.assign(
+                    counts.size(),
+                    [&counts](std::uint32_t i) { return counts[i]; });
+            }
+        }
+        if (!lazy_partitions_) {
+            three_sum_(&initial_3_partitions_, bin_capacity, pool);
+            three_sum_(&initial_3_partitions_, 2u * bin_capacity, pool);
+        }
     }
     Environment *env() const { return env_; }
-    std::vector<ItemCount> &items() { return items_; }
+    /*
+     * Creates a `Context` for working on this `Problem` which draws random
+     * numbers from env, or from the environment of the `Problem` if env is
+     * null.
+     */
+    Context context(Environment *env = nullptr) const {
+        return Context(env ? env : env_, items_,
+                       initial_3_partitions_.size());
+    }
     const std::vector<ItemCount> &items() const { return items_; }
     std::uint32_t bin_count() const { return bin_count_; }
     std::uint32_t bin_capacity() const { return bin_capacity_; }
@@ -336,55 +606,149 @@ class Problem {
     std::uint32_t original_item_count() const { return original_item_count_; }
     std::uint32_t original_slack() const { return original_slack_; }
     std::uint32_t slack() const { return slack_; }
-    std::uint32_t lower_bound() const { return lower_bound_; }
+    /*
+     * The lower bound on the number of cuts. It only increases, and may do so
+     * while the problem is being solved, see `BoundRefiner`.
+     */
+    std::uint32_t lower_bound() const { return lower_bound_.load(); }
+    /*
+     * Raises the lower bound to cuts, if more. Returns whether the lower
+     * bound was raised. Safe to call while the problem is being solved.
+     */
+    bool raise_lower_bound(std::uint32_t cuts) {
+        auto current = lower_bound_.load();
+        while (cuts > current) {
+            if (lower_bound_.compare_exchange_weak(current, cuts)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    /*
+     * Raises the lower bound to the cuts proven by bound, if more, as by
+     * raise_lower_bound.
+     */
+    bool tighten(const BinBound &bound) {
+        return raise_lower_bound(
+            cuts_for_bins(bound(items_, bin_capacity_), bin_count_));
+    }
+    /*
+     * Raises the lower bound to `l3star` with the given number of iterations,
+     * if more, as by raise_lower_bound.
+     */
+    bool tighten_l3star(std::uint32_t iterations) {
+        const auto first = items_.crend() - unique_size_count_;
+        return raise_lower_bound(l3star(first, items_.crend(), slack_,
+                                        bin_count_, bin_capacity_,
+                                        iterations));
+    }
     bool solved() const { return solved_; }
     /*
-     * Produces blocks from the `ItemCount` objects in the range from begin to
-     * end. The slack argument is an in/out parameter for the amount of slack
-     * available. The item_count argument is an in/out parameter for the number
-     * of unpacked items. The solution argument points to the solution which
-     * should be processed. Returns the number of bins used.
+     * Sets whether G+ draws the order of its items from their counts instead
+     * of shuffling them, see g_plus. Must not be called while the problem is
+     * being solved.
      */
-    template <class InputIt>
-    std::uint32_t b3(InputIt begin, InputIt end, std::uint32_t *slack,
-            std::uint32_t *item_count, Solution *solution) const {
-        if (begin == end) {
+    void set_sample_items(bool sample) { sample_items_ = sample; }
+    bool sample_items() const { return sample_items_; }
+    /*
+     * Produces blocks from the items counted in the context. The slack argument
+     * is an in/out parameter for the amount of slack available. The item_count
+     * argument is an in/out parameter for the number of unpacked items. The
+     * solution argument points to the solution which should be processed.
+     * The 3-partitions are tried starting from the initial order of the
+     * context. Returns the number of bins used.
+     */
+    std::uint32_t b3(Context *context, std::uint32_t *slack,
+                     std::uint32_t *item_count, Solution *solution) const {
+        if (items_.empty()) {
             return 0u;
         }
-        std::vector<Partition> partitions;
-        partitions.reserve(initial_3_partitions_.size());
-        threesum(begin, end, &partitions, 1u, bin_capacity_);
-        threesum(begin, end, &partitions, 2u, bin_capacity_);
-
-        return find_packing(partitions.begin(), partitions.end(), slack,
-                            item_count, &*--end, solution);
+        context->restart();
+        return find_packing(context, slack, item_count, solution);
     }
     /*
-     * Shuffles the range of items from begin to end and finds blocks therein,
-     * given the amount of slack available. Found blocks are written to the out
-     * iterator.
+     * Shuffles the last count items of solution and finds blocks therein,
+     * given the amount of slack available. Found blocks are appended to the
+     * solution.
      */
-    template <class RandomIt, class OutputIt>
-    constexpr void g(RandomIt begin, RandomIt end, std::uint32_t *slack,
-                     OutputIt out) const {
-        if (begin == end) {
+    void g(Context *context, Solution *solution, std::uint32_t count,
+           std::uint32_t *slack) const {
+        if (!count) {
             return;
         }
-        optimizer::shuffle(begin, end, *env_->rng());
+        auto &items = solution->items();
+        optimizer::shuffle(items.end() -= count, items.end(),
+                           *context->env()->rng());
         const auto slack_in = *slack;
         *slack = 0u;
-        next_fit_fragmentation(*this, begin, end, slack_in, out);
+        next_fit_fragmentation(*this, solution, items.size() - count,
+                               slack_in);
+    }
+    /*
+     * Runs G+ on item_count items, those counted in the context and any left
+     * at the end of solution without a block, and bin_count - 1 dummy items:
+     * appends them to solution in random order and finds blocks therein,
+     * given the amount of slack available. If the problem samples items, see
+     * set_sample_items, the order is drawn from the counts with the
+     * `CountSampler` of the context, which takes the loose items back into
+     * the counts, instead of shuffling the appended items. The sampler needs
+     * memory for the distinct sizes only, where shuffling runs over all the
+     * items; both give the same distribution of blocks, but shuffling is
+     * faster.
+     */
+    void g_plus(Context *context, Solution *solution, std::uint32_t item_count,
+                std::uint32_t bin_count, std::uint32_t *slack) const {
+        auto &items = solution->items();
+        auto &counts = context->items();
+        const auto w = static_cast<std::uint32_t>(items_.size());
+        const auto dummies = bin_count - 1u;
+        const auto count = item_count + dummies;
+
+        if (!sample_items_) {
+            for (auto i = 0u; i < w; ++i) {
+                items.insert(items.end(), counts[i].count, i);
+            }
+            items.insert(items.end(), dummies, dummy_item);
+            g(context, solution, count, slack);
+            return;
+        }
+
+        if (!count) {
+            return;
+        }
+        // items left at the end of solution without a block are drawn anew
+        auto counted = std::uint32_t{};
+        for (auto i = 0u; i < w; ++i) {
+            counted += counts[i].count;
+        }
+        for (auto it = items.cend() - (item_count - counted);
+             it != items.cend(); ++it) {
+            ++counts[*it].count;
+        }
+        items.resize(items.size() - (item_count - counted));
+        auto &sampler = context->sampler();
+        sampler.assign(w + 1u, [&counts, w, dummies](std::uint32_t i) {
+            return i < w ? counts[i].count : dummies;
+        });
+        auto &rng = *context->env()->rng();
+        for (auto remaining = count; remaining > 0u; --remaining) {
+            const auto i = sampler.take(bounded_rand(remaining, rng));
+            items.push_back(i < w ? i : dummy_item);
+        }
+        const auto slack_in = *slack;
+        *slack = 0u;
+        next_fit_fragmentation(*this, solution, items.size() - count,
+                               slack_in);
     }
     /*
      * Produces an initial solution. If parameter do_b3 is `true`, algorithm
      * B_3 G^+ is used, else only G^+ is used.
      */
     template <bool do_b3 = true>
-    std::unique_ptr<Solution> generate_individual() {
+    std::unique_ptr<Solution> generate_individual(Context *context) const {
         auto result = std::make_unique<Solution>();
-        const auto items_copy(items_);
         auto item_count(item_count_);
-        const auto max_blocks = bin_count_ - lower_bound_;
+        const auto max_blocks = bin_count_ - lower_bound();
         auto bin_count(bin_count_);
 
         auto slack(slack_);
@@ -392,29 +756,18 @@ class Problem {
         result->blocks().reserve(max_blocks);
 
         if (do_b3) {
-            bin_count -= find_packing(
-                initial_3_partitions_.begin(), initial_3_partitions_.end(),
-                &slack, &item_count, &items_.back(), result.get());
+            bin_count -= find_packing(context, &slack, &item_count,
+                                      result.get());
         }
 
         if (item_count != 0u) {
-            for (auto &v : items_) {
-                std::fill_n(std::back_inserter(result->items()), v.count, &v);
-            }
-            const auto dummies = bin_count - 1u;
-            std::fill_n(std::back_inserter(result->items()), dummies, nullptr);
-
-            g(result->items().end() -= item_count + dummies,
-              result->items().end(), &slack,
-              std::back_inserter(result->blocks()));
+            g_plus(context, result.get(), item_count, bin_count, &slack);
         }
 
-        std::sort(result->blocks().begin(), result->blocks().end(),
-                  [c = bin_capacity_](const auto &l, const auto &r) {
-                      return l.score(c) < r.score(c);
-                  });
+        result->sort_blocks(0u, &context->blocks());
+        result->rehash();
 
-        std::copy(items_copy.cbegin(), items_copy.cend(), items_.begin());
+        std::copy(items_.cbegin(), items_.cend(), context->items().begin());
         return result;
     }
 };
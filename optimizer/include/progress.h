@@ -0,0 +1,94 @@
+#ifndef PROGRESS_H_
+#define PROGRESS_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "deadline.h"
+
+namespace optimizer {
+
+/*
+ * The progress of a running solve, which other threads may read at any time
+ * without locking, and a flag through which they may cancel it. The solver
+ * writes the generation and the number of blocks of its best solution
+ * together, so a reader never sees one without the other, and the time of the
+ * last improvement before them, so it is never older than the best read.
+ */
+class Progress {
+    typedef Deadline::Clock Clock;
+
+    std::atomic<std::uint64_t> state_;
+    std::atomic<Clock::rep> improved_;
+    std::atomic<bool> cancelled_;
+
+ public:
+    Progress()
+        : state_{0u}, improved_{Clock::now().time_since_epoch().count()},
+          cancelled_{false} {}
+    Progress(const Progress &) = delete;
+    Progress &operator=(const Progress &) = delete;
+    /*
+     * Asks the solve to stop, which it does before its next generation and
+     * returns the best solution so far.
+     */
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+    bool cancelled() const {
+        return cancelled_.load(std::memory_order_relaxed);
+    }
+    /*
+     * Returns the number of generations which have passed.
+     */
+    std::uint32_t generation() const {
+        return static_cast<std::uint32_t>(
+            state_.load(std::memory_order_acquire) >> 32u);
+    }
+    /*
+     * Returns the number of blocks of the best solution so far.
+     */
+    std::uint32_t best() const {
+        return static_cast<std::uint32_t>(
+            state_.load(std::memory_order_acquire));
+    }
+    /*
+     * Reads the generation and the best number of blocks at once.
+     */
+    void read(std::uint32_t *generation, std::uint32_t *best) const {
+        const auto state = state_.load(std::memory_order_acquire);
+        *generation = static_cast<std::uint32_t>(state >> 32u);
+        *best = static_cast<std::uint32_t>(state);
+    }
+    /*
+     * Returns the time since the best solution last improved, or since the
+     * progress was created or reset if it has not.
+     */
+    Clock::duration since_improvement() const {
+        return Clock::now().time_since_epoch() -
+               Clock::duration(improved_.load(std::memory_order_acquire));
+    }
+    /*
+     * Records the start of a solve whose initial best solution has best
+     * blocks. A cancel which came before is kept.
+     */
+    void reset(std::uint32_t best) {
+        improved_.store(Clock::now().time_since_epoch().count(),
+                        std::memory_order_relaxed);
+        state_.store(best, std::memory_order_release);
+    }
+    /*
+     * Records that generation has passed, with a best solution of best
+     * blocks, which is an improvement if improved is set.
+     */
+    void update(std::uint32_t generation, std::uint32_t best, bool improved) {
+        if (improved) {
+            improved_.store(Clock::now().time_since_epoch().count(),
+                            std::memory_order_relaxed);
+        }
+        state_.store(static_cast<std::uint64_t>(generation) << 32u | best,
+                     std::memory_order_release);
+    }
+};
+
+} // namespace optimizer
+
+#endif
@@ -1,100 +1,154 @@
 #ifndef REPLACERS_H_
 #define REPLACERS_H_
 
+#include <assert.h>
+
 #include <algorithm>
-#include <array>
 #include <memory>
 #include <vector>
 
+#include "parameters.h"
 #include "solution.h"
 #include "util.h"
 
 namespace optimizer {
 
+/*
+ * Collects the hashes of the individuals from first to last in hashes, sorted,
+ * and returns a function which determines if a solution is a duplicate of
+ * one of them, or of a solution it was asked about before and found not to
+ * be. Equal hashes are taken for equal solutions. If hashes is null, no
+ * solution is a duplicate.
+ */
+inline auto duplicate_filter(Population::const_iterator first,
+                             Population::const_iterator last,
+                             std::vector<std::uint64_t> *hashes) {
+    auto known = std::size_t{};
+    if (hashes) {
+        hashes->resize(last - first);
+        std::transform(first, last, hashes->begin(),
+                       [](const auto &sol) { return sol->hash(); });
+        std::sort(hashes->begin(), hashes->end());
+        known = hashes->size();
+    }
+    return [hashes, known](const Solution &sol) {
+        if (!hashes) {
+            return false;
+        }
+        const auto hash = sol.hash();
+        if (std::binary_search(hashes->cbegin(), hashes->cbegin() + known,
+                               hash) ||
+            std::find(hashes->cbegin() + known, hashes->cend(), hash) !=
+                hashes->cend()) {
+            return true;
+        }
+        hashes->push_back(hash);
+        return false;
+    };
+}
+
 /*
  * Performs controlled replacement of solutions in the population from
- * progeny produced by grouping crossover and the random individuals.
- * Template parameters are `NP`, the population size, `NC` the number
- * of individuals to undergo crossover, and `NE` is the size of the elite set.
+ * progeny produced by grouping crossover and the random individuals r, using
+ * buffer, counts and hashes as temporary storage. Unless hashes is null, a
+ * child which duplicates an individual or an earlier child is rejected, and
+ * the individual it would have replaced stays. The template parameter `NP` is
+ * the size of the population if it is fixed at compile time, or 0 if it is
+ * not. The solutions replaced and the children rejected are left in progeny.
  */
-template <std::uint32_t NP, std::uint32_t NC, std::uint32_t NE>
-void controlled_replacement_crossover(
-    std::array<std::unique_ptr<Solution>, NP> *population,
-    std::array<std::unique_ptr<Solution>, NC> *progeny,
-    std::array<Solution *, NC / 2u> *r) {
-    std::sort(r->begin(), r->end());
-    std::sort(population->begin() + NE, population->end());
-
-    std::array<std::unique_ptr<Solution>, NP - NC / 2u - NE> p_minus_r_minus_b;
-    std::set_difference(
-        std::make_move_iterator(population->begin() + NE),
-        std::make_move_iterator(population->end()), r->cbegin(), r->cend(),
-        p_minus_r_minus_b.begin(),
-        [](const auto &left, const auto &right) { return &*left < &*right; });
-
-    std::sort(p_minus_r_minus_b.begin(), p_minus_r_minus_b.end(),
-              [](const auto &left, const auto &right) {
-                  return left->size() > right->size();
-              });
-
-    auto it = dedup(p_minus_r_minus_b.begin(), p_minus_r_minus_b.end(), NC / 2u,
+template <std::uint32_t NP = 0u>
+void controlled_replacement_crossover(const Parameters &params,
+                                      Population *population,
+                                      Population *progeny,
+                                      const std::vector<Solution *> &r,
+                                      Population *buffer,
+                                      std::vector<std::uint32_t> *counts,
+                                      std::vector<std::uint64_t> *hashes) {
+    const auto np = NP ? NP : static_cast<std::uint32_t>(population->size());
+    assert(population->size() == np && progeny->size() == params.nc);
+    assert(params.ne < np && params.nc <= np - params.ne);
+    const auto half = params.nc / 2u;
+    const auto first = population->begin() + params.ne;
+    const auto last = population->begin() + np;
+    const auto duplicate = duplicate_filter(population->cbegin(), last, hashes);
+
+    // the rest comes first in buffer and the parents in r last, both in the
+    // order of the population, so the rest is sorted by decreasing size
+    buffer->resize(np - params.ne);
+    const auto rest = buffer->begin();
+    const auto parents = buffer->begin() + (np - params.ne - half);
+    auto rest_out = rest;
+    auto parent_out = parents;
+    for (auto it = first; it != last; ++it) {
+        if (std::find(r.cbegin(), r.cend(), it->get()) != r.cend()) {
+            *parent_out++ = std::move(*it);
+        } else {
+            *rest_out++ = std::move(*it);
+        }
+    }
+
+    auto it = dedup(rest, parents, half,
                     [](const auto &left, const auto &right) {
                         return left->size() == right->size();
                     });
 
-    if (static_cast<std::uint32_t>(p_minus_r_minus_b.end() - it) < NC / 2u) {
-        it -= NC / 2u - (p_minus_r_minus_b.end() - it);
+    if (static_cast<std::uint32_t>(parents - it) < half) {
+        it -= half - (parents - it);
+    }
+
+    // the children of the good individuals replace the parents in r, and
+    // the others the duplicates among the rest
+    for (auto i = 0u; i < half; ++i) {
+        if (!duplicate(*(*progeny)[i])) {
+            std::swap((*progeny)[i], parents[i]);
+        }
+    }
+    for (auto i = half; i < params.nc; ++i, ++it) {
+        if (!duplicate(*(*progeny)[i])) {
+            std::swap((*progeny)[i], *it);
+        }
     }
 
-    std::move(progeny->begin() + NC / 2u, progeny->end(), it);
-
-    std::move(progeny->begin(), progeny->begin() + NC / 2u,
-              population->begin() + NE);
-    std::move(p_minus_r_minus_b.begin(), p_minus_r_minus_b.end(),
-              population->begin() + NE + NC / 2u);
-    std::sort(population->begin() + NE, population->end(),
-              [](const auto &left, const auto &right) {
-                  return left->size() > right->size();
-              });
-    std::inplace_merge(population->begin(), population->begin() + NE,
-                       population->end(),
-                       [](const auto &left, const auto &right) {
-                           return left->size() > right->size();
-                       });
+    std::move(parents, buffer->end(), first);
+    std::move(rest, parents, first + half);
+    // the elite set comes first, so it is kept ahead of equal sizes
+    sort_population(population->begin(), last, buffer, counts);
 }
 
 /*
- * Performs controlled replacement of cloned individuals into the population.
- * The parameter `NP` indicates the size of the population.
+ * Performs controlled replacement of cloned individuals into the population,
+ * using buffer, counts and hashes as temporary storage. Unless hashes is
+ * null, clones which duplicate an individual or an earlier clone are
+ * rejected. The template parameter `NP` is as for
+ * `controlled_replacement_crossover`. The solutions replaced and the clones
+ * rejected are left in cloned.
  */
-template <std::uint32_t NP>
-void controlled_replacement_mutation(
-    std::array<std::unique_ptr<Solution>, NP> *population,
-    std::vector<std::unique_ptr<Solution>> *cloned) {
-    std::sort(cloned->begin(), cloned->end(),
-              [](const auto &left, const auto &right) {
-                  return left->size() > right->size();
-              });
+template <std::uint32_t NP = 0u>
+void controlled_replacement_mutation(Population *population,
+                                     Population *cloned, Population *buffer,
+                                     std::vector<std::uint32_t> *counts,
+                                     std::vector<std::uint64_t> *hashes) {
+    const auto np = NP ? NP : static_cast<std::uint32_t>(population->size());
+    assert(population->size() == np);
+    const auto last = population->begin() + np;
+    const auto duplicate = duplicate_filter(population->cbegin(), last, hashes);
 
     auto it = dedup(
-        population->begin(), population->end(), cloned->size(),
+        population->begin(), last, cloned->size(),
         [](const auto &l, const auto &r) { return l->size() == r->size(); });
 
-    if (static_cast<std::uint32_t>(population->end() - it) < cloned->size()) {
-        it -= cloned->size() - (population->end() - it);
+    if (static_cast<std::uint32_t>(last - it) < cloned->size()) {
+        it -= cloned->size() - (last - it);
+    }
+
+    for (auto &clone : *cloned) {
+        if (!duplicate(*clone)) {
+            std::swap(clone, *it);
+        }
+        ++it;
     }
 
-    std::move(cloned->begin(), cloned->end(), it);
-
-    std::inplace_merge(population->begin(), it, it + cloned->size(),
-                       [](const auto &left, const auto &right) {
-                           return left->size() > right->size();
-                       });
-    std::inplace_merge(population->begin(), it += cloned->size(),
-                       population->end(),
-                       [](const auto &left, const auto &right) {
-                           return left->size() > right->size();
-                       });
+    sort_population(population->begin(), last, buffer, counts);
 }
 
 } // namespace optimizer
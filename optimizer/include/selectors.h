@@ -4,68 +4,80 @@
 #include <assert.h>
 
 #include <algorithm>
-#include <array>
 #include <memory>
 #include <random>
 #include <vector>
 
 #include "environment.h"
+#include "parameters.h"
+#include "solution.h"
 #include "util.h"
 
 namespace optimizer {
 
 /*
- * Performs controlled selection for crossover. Selects `NC` individuals from
- * the population into sets `g` for good solutions and `r` for random solutions.
- * Parameters `NP` and `NE` are the size of the population and the size of the
- * elite set.
+ * Performs controlled selection for crossover. Selects `nc` individuals from
+ * the population into sets g for good solutions and r for random solutions,
+ * drawing random numbers from env, with scratch as temporary storage. The
+ * template parameter `NP` is the size of the population if it is fixed at
+ * compile time, or 0 if it is not.
  */
-template <std::uint32_t NP, std::uint32_t NC, std::uint32_t NE>
-void controlled_selection_crossover(
-    Problem *problem, std::array<std::unique_ptr<Solution>, NP> *population,
-    std::array<Solution *, NC / 2u> *g, std::array<Solution *, NC / 2u> *r) {
-    static_assert(NC >= 2u, "NC must be at least 2");
-    std::array<Solution *, NC> p_copy1;
-    std::array<Solution *, NP - NE> p_copy2;
-    std::transform(population->cbegin(), population->cbegin() + NC,
-                   p_copy1.begin(), [](const auto &sol) { return sol.get(); });
-    std::transform(population->cbegin() + NE, population->cend(),
-                   p_copy2.begin(), [](const auto &sol) { return sol.get(); });
-    std::copy_n(sample_inplace(p_copy1.begin(), p_copy1.end(), g->size(),
-                               *problem->env()->rng()),
-                g->size(), g->begin());
-    std::copy_n(sample_inplace(p_copy2.begin(), p_copy2.end(), r->size(),
-                               *problem->env()->rng()),
-                r->size(), r->begin());
+template <std::uint32_t NP = 0u>
+void controlled_selection_crossover(Environment *env, const Parameters &params,
+                                    Population *population,
+                                    std::vector<Solution *> *scratch,
+                                    std::vector<Solution *> *g,
+                                    std::vector<Solution *> *r) {
+    const auto np = NP ? NP : static_cast<std::uint32_t>(population->size());
+    assert(population->size() == np);
+    const auto half = params.nc / 2u;
+    assert(half >= 2u);
+    const auto get = [](const auto &sol) { return sol.get(); };
+
+    scratch->resize(params.nc);
+    std::transform(population->cbegin(), population->cbegin() + params.nc,
+                   scratch->begin(), get);
+    const auto good =
+        sample_inplace(scratch->begin(), scratch->end(), half, *env->rng());
+    g->assign(scratch->begin(), good);
+    scratch->resize(np - params.ne);
+    std::transform(population->cbegin() + params.ne,
+                   population->cbegin() + np, scratch->begin(), get);
+    const auto random =
+        sample_inplace(scratch->begin(), scratch->end(), half, *env->rng());
+    r->assign(scratch->begin(), random);
 
     auto i = 0u;
-    for (; i < NC / 2u - 1u; ++i) {
+    for (; i < half - 1u; ++i) {
         if ((*g)[i] == (*r)[i]) {
             std::swap((*g)[i], (*g)[i + 1u]);
             ++i;
         }
     }
-    if (i == NC / 2u - 1u && (*g)[NC / 2u - 1u] == (*r)[NC / 2u - 1u]) {
-        std::swap((*g)[NC / 2u - 2u], (*g)[NC / 2u - 1u]);
+    if (i == half - 1u && (*g)[half - 1u] == (*r)[half - 1u]) {
+        std::swap((*g)[half - 2u], (*g)[half - 1u]);
     }
 }
 
 /*
- * Performs controlled selection for mutation. Selects `NM` individuals from the
- * population, possibly cloning some of them and mutating others.
+ * Performs controlled selection for mutation. Selects `nm` individuals from
+ * the population, possibly cloning some of them and mutating others. Both
+ * are listed in the order of the population.
  */
-template <std::uint32_t NP, std::uint32_t NM, std::uint32_t NE,
-          std::uint32_t LS>
-constexpr void controlled_selection_mutation(
-    const std::array<std::unique_ptr<Solution>, NP> &population,
-    std::vector<Solution *> *clones, std::array<Solution *, NM> *mutants) {
-    auto end = population.cbegin() + NE;
+template <std::uint32_t NP = 0u>
+void controlled_selection_mutation(const Parameters &params,
+                                   const Population &population,
+                                   std::vector<Solution *> *clones,
+                                   std::vector<Solution *> *mutants) {
+    assert(!NP || population.size() == NP);
+    auto end = population.cbegin() + params.ne;
     for (auto it = population.cbegin(); it != end; ++it) {
-        if ((*it)->age() < LS) {
+        if ((*it)->age() < params.ls) {
             clones->push_back(it->get());
         }
     }
-    std::transform(population.cbegin(), population.cbegin() + NM,
+    mutants->resize(params.nm);
+    std::transform(population.cbegin(), population.cbegin() + params.nm,
                    mutants->begin(), [](const auto &sol) { return sol.get(); });
 }
 
@@ -6,105 +6,169 @@
 #include <iostream>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <utility>
 #include <vector>
 
 #include "item.h"
+#include "util.h"
 
 namespace optimizer {
 
+class Context;
 class Problem;
 
 /*
- * A `Solution` consists of a number of `Block`s with `Item`s.
+ * A `Solution` consists of a number of `Block`s with `Item`s. Items are stored
+ * as indices into the items of the `Problem`, and blocks as ranges of offsets
+ * into the items of the solution, so copying a solution copies two flat arrays.
+ * The operators producing solutions keep the blocks sorted by increasing score.
  */
 class Solution {
  public:
     /*
      * A Block is a set of items and a number of bins with equal capacity.
      * For each additional bin, a cut ensues, so the number of fragments
-     * increases.
+     * increases. The score of a block is kept current as it changes. The
+     * items of a block are sorted by index, so copies of an item are adjacent.
+     * The key of a block is the sum of the Zobrist keys of its items, which
+     * does not depend on their order or offsets, and is kept by copies.
      */
     class Block {
-        friend std::ostream &operator<<(std::ostream &os, const Block &block) {
-            if (block.begin_ == block.end_) {
-                os << "()";
-            } else {
-                std::sort(block.begin_, block.end_,
-                          [](const auto &l, const auto &r) { return l < r; });
-                auto it = block.begin_;
-                os << '(' << (*it)->size;
-                for (++it; it != block.end_; ++it) {
-                    os << ", " << (*it)->size;
-                }
-                os << ')';
-            }
-            return os;
-        }
-        std::vector<ItemCount *>::iterator begin_;
-        std::vector<ItemCount *>::iterator end_;
+        std::uint32_t begin_;
+        std::uint32_t end_;
         std::uint32_t bin_count_;
         std::uint32_t size_;
+        std::uint32_t score_;
+        std::uint32_t key_;
 
         std::uint32_t capacity(std::uint32_t bin_capacity) const {
             return bin_count_ * bin_capacity;
         }
+        /*
+         * Returns the Zobrist key of the item with index item, a fixed
+         * pseudorandom function of the index.
+         */
+        static std::uint32_t item_key(std::uint32_t item) {
+            auto x = (item + 1u) * 0x9e3779b9u;
+            x ^= x >> 16u;
+            x *= 0x85ebca6bu;
+            x ^= x >> 13u;
+            x *= 0xc2b2ae35u;
+            return x ^ x >> 16u;
+        }
 
      public:
         Block() = default;
-        Block(std::vector<ItemCount *>::iterator begin,
-              std::vector<ItemCount *>::iterator end, std::uint32_t bin_count,
-              std::uint32_t size)
-            : begin_{begin}, end_{end}, bin_count_{bin_count}, size_{size} {}
-        void put(ItemCount *item, std::uint32_t bin_capacity) {
-            if (item) {
-                size_ += item->size;
-                if (size_ > capacity(bin_capacity)) {
-                    ++bin_count_;
-                }
+        Block(std::uint32_t begin, std::uint32_t end, std::uint32_t bin_count,
+              std::uint32_t size, std::uint32_t bin_capacity)
+            : begin_{begin}, end_{end}, bin_count_{bin_count}, size_{size},
+              score_{}, key_{} {
+            rescore(bin_capacity);
+        }
+        /*
+         * Returns a copy of the block with its items starting at offset begin.
+         */
+        Block at(std::uint32_t begin) const {
+            auto result = *this;
+            result.begin_ = begin;
+            result.end_ = begin + item_count();
+            return result;
+        }
+        /*
+         * Appends the next item of the solution, of size item_size, to the
+         * block. Dummy items have size 0.
+         */
+        void put(std::uint32_t item_size, std::uint32_t bin_capacity) {
+            size_ += item_size;
+            if (size_ > capacity(bin_capacity)) {
+                ++bin_count_;
             }
             ++end_;
+            rescore(bin_capacity);
+        }
+        /*
+         * Removes the dummy items of the block from items, the item array of
+         * the solution, and sorts the remaining ones.
+         */
+        void complete(std::uint32_t *items, std::uint32_t bin_capacity) {
+            end_ = static_cast<std::uint32_t>(
+                std::remove(items + begin_, items + end_, dummy_item) - items);
+            std::sort(items + begin_, items + end_);
+            rescore(bin_capacity);
+            rekey(items);
+        }
+        /*
+         * Recomputes the key of the block from items, the item array of the
+         * solution.
+         */
+        void rekey(const std::uint32_t *items) {
+            key_ = std::accumulate(items + begin_, items + end_,
+                                   std::uint32_t{},
+                                   [](std::uint32_t sum, std::uint32_t item) {
+                                       return sum + item_key(item);
+                                   });
+        }
+        /*
+         * Returns a hash of the items and the number of bins of the block.
+         * Hashes are spread over 64 bits, so that their sum over the blocks
+         * of a solution tells solutions apart although all of them hold the
+         * same items.
+         */
+        std::uint64_t hash() const {
+            auto x = static_cast<std::uint64_t>(bin_count_) << 32u | key_;
+            x ^= x >> 33u;
+            x *= 0xff51afd7ed558ccdu;
+            x ^= x >> 33u;
+            x *= 0xc4ceb9fe1a85ec53u;
+            return x ^ x >> 33u;
+        }
+        /*
+         * Recomputes the score of the block.
+         */
+        void rescore(std::uint32_t bin_capacity) {
+            const auto items = item_count();
+            score_ = items ? items + slack(bin_capacity) + bin_count_ - 1u
+                           : std::numeric_limits<std::uint32_t>::max();
         }
-        void complete() { end_ = std::remove(begin_, end_, nullptr); }
         std::uint32_t slack(std::uint32_t bin_capacity) const {
             return capacity(bin_capacity) - size_;
         }
-        std::uint32_t score(std::uint32_t bin_capacity) const {
-            const auto items = std::distance(begin_, end_);
-            return items ? items + slack(bin_capacity) + bin_count_ - 1u
-                         : std::numeric_limits<std::uint32_t>::max();
-        }
+        std::uint32_t score() const { return score_; }
         std::uint32_t size() const { return size_; }
-        std::pair<std::vector<ItemCount *>::iterator,
-                  std::vector<ItemCount *>::iterator>
-        items() const {
-            return std::make_pair(begin_, end_);
-        }
+        std::uint32_t begin() const { return begin_; }
+        std::uint32_t end() const { return end_; }
+        std::uint32_t item_count() const { return end_ - begin_; }
         std::uint32_t bin_count() const { return bin_count_; }
-        static bool allowed(const Block &block, std::uint32_t bin_capacity,
-                            std::uint32_t *slack) {
+        /*
+         * Determines if a block fits the available items and slack. The items
+         * of the block are looked up in items, the item array of its solution,
+         * and their counts in counts. The counts are only written to if the
+         * block fits, in which case its items and slack are taken.
+         */
+        static bool allowed(const Block &block, const std::uint32_t *items,
+                            std::uint32_t bin_capacity, std::uint32_t *slack,
+                            ItemCount *counts) {
             const auto block_slack = block.slack(bin_capacity);
 
             if (block_slack > *slack) {
                 return false;
             }
 
-            const auto pair = block.items();
+            const auto first = items + block.begin_;
+            const auto last = items + block.end_;
 
-            auto it = std::find_if(pair.first, pair.second, [](auto *item) {
-                if (item->count > 0u) {
-                    --item->count;
+            // the k-th copy of an item in its run needs a count of at least k
+            auto run = 0u;
+            for (auto it = first; it != last; ++it) {
+                run = it != first && it[-1] == *it ? run + 1u : 1u;
+                if (counts[*it].count < run) {
                     return false;
                 }
-                return true;
-            });
+            }
 
-            if (it != pair.second) {
-                for (auto rit = std::make_reverse_iterator(it);
-                     rit != std::make_reverse_iterator(pair.first); ++rit) {
-                    ++((*rit)->count);
-                }
-                return false;
+            for (auto it = first; it != last; ++it) {
+                --counts[*it].count;
             }
 
             *slack -= block_slack;
@@ -113,57 +177,164 @@ class Solution {
         }
     };
 
-    Solution() : items_{}, blocks_{}, age_{} {}
-    Solution(const Solution &other)
-        : items_(other.items()), blocks_{}, age_{other.age_} {
-        blocks_.reserve(other.blocks().size());
-        std::transform(other.blocks().cbegin(), other.blocks().cend(),
-                       std::back_inserter(blocks_),
-                       [&items = items_, &other ](const auto &b) {
-                           auto pair = b.items();
-                           return Block(items.begin() +=
-                                        (pair.first - other.items().begin()),
-                                        items.begin() +=
-                                        (pair.second - other.items().begin()),
-                                        b.bin_count(), b.size());
-                       });
-    }
+    Solution() : items_{}, blocks_{}, age_{}, hash_{} {}
+    Solution(const Solution &other) = default;
     Solution(Solution &&other) = default;
+    /*
+     * Copies other into this solution, reusing the storage already held.
+     */
+    Solution &operator=(const Solution &other) = default;
     Solution &operator=(Solution &&other) = default;
-    Solution &operator=(const Solution &other) {
-        auto temp(other);
-        return *this = std::move(temp);
+    /*
+     * Empties the solution but keeps its storage.
+     */
+    void clear() {
+        items_.clear();
+        blocks_.clear();
+        age_ = 0u;
+        hash_ = 0u;
     }
     std::uint32_t size() const { return blocks_.size(); }
-    const std::vector<ItemCount *> &items() const { return items_; }
-    std::vector<ItemCount *> &items() { return items_; }
+    const std::vector<std::uint32_t> &items() const { return items_; }
+    std::vector<std::uint32_t> &items() { return items_; }
+    /*
+     * Returns the range of indices of the items in block.
+     */
+    std::pair<const std::uint32_t *, const std::uint32_t *>
+    items(const Block &block) const {
+        return std::make_pair(items_.data() + block.begin(),
+                              items_.data() + block.end());
+    }
     const std::vector<Block> &blocks() const { return blocks_; }
     std::vector<Block> &blocks() { return blocks_; }
+    /*
+     * Merges the blocks from offset middle onwards into the blocks before
+     * them, both sorted by increasing score, using buffer as temporary
+     * storage.
+     */
+    void merge_blocks(std::uint32_t middle, std::vector<Block> *buffer) {
+        if (!middle || middle == blocks_.size()) {
+            return;
+        }
+        buffer->resize(blocks_.size());
+        inplace_merge(blocks_.begin(), blocks_.begin() + middle, blocks_.end(),
+                      buffer->begin(), [](const Block &l, const Block &r) {
+                          return l.score() < r.score();
+                      });
+    }
+    /*
+     * Sorts the blocks by increasing score, given that the first sorted
+     * blocks are in order already, using buffer as temporary storage.
+     */
+    void sort_blocks(std::uint32_t sorted, std::vector<Block> *buffer) {
+        std::sort(blocks_.begin() + sorted, blocks_.end(),
+                  [](const Block &l, const Block &r) {
+                      return l.score() < r.score();
+                  });
+        merge_blocks(sorted, buffer);
+    }
     unsigned int age() const { return age_; }
     void increase_age(unsigned int increment = 1u) { age_ += increment; }
+    /*
+     * Returns the hash of the solution, the sum of the hashes of its blocks,
+     * which is equal for solutions with the same blocks in any order. It is
+     * current once an operator has produced the solution.
+     */
+    std::uint64_t hash() const { return hash_; }
+    /*
+     * Recomputes the hash of the solution from the keys its blocks carry,
+     * without reading their items.
+     */
+    void rehash() {
+        hash_ = std::accumulate(
+            blocks_.cbegin(), blocks_.cend(), std::uint64_t{},
+            [](std::uint64_t sum, const Block &b) { return sum + b.hash(); });
+    }
 
  private:
-    std::vector<ItemCount *> items_;
+    std::vector<std::uint32_t> items_;
     std::vector<Block> blocks_;
     unsigned int age_;
+    std::uint64_t hash_;
+
+    template <bool use_b3>
+    friend void adaptive_mutation(const Problem *problem, Context *context,
+                                  double k, Solution *mutant);
+};
+
+/*
+ * A population of solutions, kept sorted by decreasing size by the solvers.
+ */
+typedef std::vector<std::unique_ptr<Solution>> Population;
+
+/*
+ * Sorts the individuals from first to last by decreasing size, keeping the
+ * order of those of equal size, using buffer and counts as temporary storage.
+ * Sizes are bounded by the number of bins, so this takes linear time.
+ */
+inline void sort_population(Population::iterator first,
+                            Population::iterator last, Population *buffer,
+                            std::vector<std::uint32_t> *counts) {
+    if (buffer->size() < static_cast<std::size_t>(last - first)) {
+        buffer->resize(last - first);
+    }
+    counting_sort(first, last, buffer->begin(),
+                  [](const std::unique_ptr<Solution> &sol) {
+                      return sol->size();
+                  },
+                  counts);
+}
+
+/*
+ * A `Solution` together with the items its indices refer to, which can be
+ * written to a stream.
+ */
+class FormattedSolution {
+    const Solution &solution_;
+    const std::vector<ItemCount> &items_;
+
+    void write(std::ostream &os, const Solution::Block &block) const {
+        const auto pair = solution_.items(block);
+        if (pair.first == pair.second) {
+            os << "()";
+            return;
+        }
+        auto it = pair.first;
+        os << '(' << items_[*it].size;
+        for (++it; it != pair.second; ++it) {
+            os << ", " << items_[*it].size;
+        }
+        os << ')';
+    }
 
-    template <intmax_t Num, intmax_t Dom, bool use_b3>
-    friend void adaptive_mutation(Problem *problem, Solution *mutant);
+ public:
+    FormattedSolution(const Solution &solution,
+                      const std::vector<ItemCount> &items)
+        : solution_(solution), items_(items) {}
 
     friend std::ostream &operator<<(std::ostream &os,
-                                    const Solution &solution) {
-        if (solution.size()) {
-            auto it = solution.blocks().cbegin();
-            os << *it;
-            for (++it; it != solution.blocks().cend(); ++it) {
-                os << ", " << *it;
+                                    const FormattedSolution &formatted) {
+        const auto &blocks = formatted.solution_.blocks();
+        if (!blocks.empty()) {
+            auto it = blocks.cbegin();
+            formatted.write(os, *it);
+            for (++it; it != blocks.cend(); ++it) {
+                os << ", ";
+                formatted.write(os, *it);
             }
         }
         return os;
     }
 };
 
+/*
+ * Prepares solution, whose indices refer to items, for writing to a stream.
+ */
+inline FormattedSolution format(const Solution &solution,
+                                const std::vector<ItemCount> &items) {
+    return FormattedSolution(solution, items);
+}
+
 } // namespace optimizer
 
 #endif
-
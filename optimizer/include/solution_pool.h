@@ -0,0 +1,66 @@
+#ifndef SOLUTION_POOL_H_
+#define SOLUTION_POOL_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "solution.h"
+
+namespace optimizer {
+
+/*
+ * A free list of `Solution`s. Released solutions keep the storage of their
+ * items and blocks, so once the pool holds enough of them, acquiring a
+ * solution does not allocate memory.
+ */
+class SolutionPool {
+    std::vector<std::unique_ptr<Solution>> free_;
+
+ public:
+    SolutionPool() : free_{} {}
+    /*
+     * Returns an empty solution.
+     */
+    std::unique_ptr<Solution> acquire() {
+        if (free_.empty()) {
+            return std::make_unique<Solution>();
+        }
+        auto result = std::move(free_.back());
+        free_.pop_back();
+        result->clear();
+        return result;
+    }
+    /*
+     * Returns a copy of other.
+     */
+    std::unique_ptr<Solution> acquire(const Solution &other) {
+        if (free_.empty()) {
+            return std::make_unique<Solution>(other);
+        }
+        auto result = std::move(free_.back());
+        free_.pop_back();
+        *result = other;
+        return result;
+    }
+    /*
+     * Takes back a solution. Null pointers are ignored.
+     */
+    void release(std::unique_ptr<Solution> solution) {
+        if (solution) {
+            free_.push_back(std::move(solution));
+        }
+    }
+    /*
+     * Takes back the solutions in the range from begin to end.
+     */
+    template <class InputIt> void release(InputIt begin, InputIt end) {
+        for (; begin != end; ++begin) {
+            release(std::move(*begin));
+        }
+    }
+};
+
+} // namespace optimizer
+
+#endif
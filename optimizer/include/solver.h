@@ -1,116 +1,313 @@
 #ifndef SOLVER_H_
 #define SOLVER_H_
 
-#include <array>
+#include <assert.h>
+
+#include <algorithm>
+#include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
 
+#include "context.h"
+#include "deadline.h"
+#include "environment.h"
 #include "operators.h"
+#include "parameters.h"
+#include "progress.h"
 #include "replacers.h"
 #include "selectors.h"
 #include "solution.h"
+#include "solution_pool.h"
+#include "thread_pool.h"
 
 namespace optimizer {
 
 /*
- * The `Solver` class solves a problem using the grouping genetic algorithm.
+ * A function the solvers call with the best solution found so far and the
+ * number of generations it took to find it, each time the best improves. The
+ * solution is only valid for the duration of the call.
+ */
+typedef std::function<void(const Solution &, std::uint32_t)> BestCallback;
+
+/*
+ * The `Solver` class solves a problem using the grouping genetic algorithm,
+ * with the `Parameters` given at construction.
  */
-template <std::uint32_t NP = 100u, std::uint32_t NC = 20u,
-          std::uint32_t NM = 83u, std::uint32_t NE = 10u,
-          std::uint32_t LS = 10u, std::uint32_t NG = 500u,
-          std::uint32_t DL = 100u, typename k1 = std::ratio<13u, 10u>,
-          typename k2 = std::ratio<4u, 1u>>
 class Solver {
-    Problem *problem_;
+    const Problem *problem_;
+    ThreadPool *pool_;
+    Parameters params_;
+    Environment *env_;
+    std::vector<std::unique_ptr<Environment>> envs_;
+    std::vector<Context> contexts_;
+    SolutionPool free_;
+    std::vector<Solution *> g_;
+    std::vector<Solution *> r_;
+    std::vector<Solution *> scratch_;
+    std::vector<Solution *> mutants_;
+    std::vector<Solution *> clones_;
+    std::vector<Solution *> pure_;
+    Population progeny_;
+    Population cloned_;
+    Population buffer_;
+    std::vector<std::uint32_t> counts_;
+    std::vector<std::uint64_t> hashes_;
+    void (Solver::*step_)(Population *);
+    Deadline deadline_;
+    BestCallback on_best_;
+    Progress *progress_;
+
+    /*
+     * Calls f(context, i) for every i in [0, n). On a pool, each context
+     * handles every k-th index, where k is the number of contexts, and task i
+     * runs on a sub-stream of its own split off the environment of the
+     * problem, so the outcome depends neither on thread timing nor on the
+     * number of threads.
+     */
+    template <class F> void for_each_task(std::uint32_t n, F &&f) {
+        if (!pool_) {
+            for (auto i = 0u; i < n; ++i) {
+                f(&contexts_[0], i);
+            }
+            return;
+        }
+        const auto k = static_cast<std::uint32_t>(contexts_.size());
+        const auto seed = problem_->env()->seed();
+        const auto first = problem_->env()->split(n);
+        pool_->parallel_for(k, [this, n, k, seed, first, &f](std::uint32_t c) {
+            auto &context = contexts_[c];
+            for (auto i = c; i < n; i += k) {
+                context.env()->reseed(seed, first + i);
+                context.restart();
+                f(&context, i);
+            }
+        });
+    }
+    /*
+     * Picks the generation step for the population size, one compiled for
+     * the size where it is a common one.
+     */
+    void select_step() {
+        assert(params_.valid());
+        switch (params_.np) {
+        case 100u:
+            step_ = &Solver::step<100u>;
+            break;
+        case 200u:
+            step_ = &Solver::step<200u>;
+            break;
+        default:
+            step_ = &Solver::step<0u>;
+            break;
+        }
+    }
+    /*
+     * Advances the population by one generation, given that it has `NP`
+     * individuals, or any number if `NP` is 0.
+     */
+    template <std::uint32_t NP> void step(Population *population) {
+        const auto nc = params_.nc;
+        controlled_selection_crossover<NP>(env_, params_, population,
+                                           &scratch_, &g_, &r_);
+        progeny_.resize(nc);
+        for (auto &child : progeny_) {
+            child = free_.acquire();
+        }
+
+        for_each_task(nc, [this, nc](Context *context, std::uint32_t j) {
+            const auto i = j / 2u;
+            if (j % 2u) {
+                gene_level_crossover<true>(problem_, context, *r_[i], *g_[i],
+                                           progeny_[i + nc / 2u].get());
+            } else {
+                gene_level_crossover<true>(problem_, context, *g_[i], *r_[i],
+                                           progeny_[i].get());
+            }
+        });
+
+        const auto hashes = params_.unique ? &hashes_ : nullptr;
+        controlled_replacement_crossover<NP>(params_, population, &progeny_,
+                                             r_, &buffer_, &counts_, hashes);
+        free_.release(progeny_.begin(), progeny_.end());
+
+        clones_.clear();
+        controlled_selection_mutation<NP>(params_, *population, &clones_,
+                                          &mutants_);
+
+        // both are in the order of the population, which unlike the
+        // addresses of the solutions is the same in every run
+        pure_.clear();
+        auto clone = clones_.cbegin();
+        for (auto *mutant : mutants_) {
+            if (clone != clones_.cend() && *clone == mutant) {
+                ++clone;
+            } else {
+                pure_.push_back(mutant);
+            }
+        }
+
+        cloned_.clear();
+        for (const auto *sol : clones_) {
+            cloned_.push_back(free_.acquire(*sol));
+        }
+
+        for_each_task(pure_.size() + clones_.size(),
+                      [this](Context *context, std::uint32_t j) {
+                          if (j < pure_.size()) {
+                              adaptive_mutation<true>(problem_, context,
+                                                      params_.k1, pure_[j]);
+                          } else {
+                              adaptive_mutation<true>(
+                                  problem_, context, params_.k2,
+                                  clones_[j - pure_.size()]);
+                          }
+                      });
+
+        sort_population(population->begin(), population->end(), &buffer_,
+                        &counts_);
+
+        if (!cloned_.empty()) {
+            controlled_replacement_mutation<NP>(population, &cloned_,
+                                                &buffer_, &counts_, hashes);
+            free_.release(cloned_.begin(), cloned_.end());
+        }
+
+        for (auto i = 0u; i < params_.ne; i++) {
+            (*population)[i]->increase_age();
+        }
+    }
 
  public:
-    explicit Solver(Problem *problem) : problem_(problem) {}
+    /*
+     * Creates a solver running on the calling thread which draws random
+     * numbers from env, or from the environment of the problem if env is null.
+     */
+    explicit Solver(const Problem *problem, Environment *env = nullptr,
+                    const Parameters &params = Parameters())
+        : problem_(problem), pool_(nullptr), params_(params), env_(nullptr),
+          envs_{}, contexts_{}, free_{}, g_{}, r_{}, scratch_{}, mutants_{},
+          clones_{}, pure_{}, progeny_{}, cloned_{}, buffer_{}, counts_{},
+          hashes_{}, step_(nullptr), deadline_{}, on_best_{},
+          progress_(nullptr) {
+        select_step();
+        contexts_.push_back(problem_->context(env));
+        env_ = contexts_[0].env();
+    }
+    /*
+     * Creates a solver running on the calling thread which draws random
+     * numbers from the environment of the problem.
+     */
+    Solver(const Problem *problem, const Parameters &params)
+        : Solver(problem, static_cast<Environment *>(nullptr), params) {}
+    /*
+     * Creates a solver which runs crossover and mutation on the threads of
+     * pool. Selection draws from a sub-stream split off the environment of
+     * the problem, and each thread gets an environment which is moved to
+     * the sub-stream of every task it runs.
+     */
+    Solver(const Problem *problem, ThreadPool *pool,
+           const Parameters &params = Parameters())
+        : problem_(problem), pool_(pool), params_(params), env_(nullptr),
+          envs_{}, contexts_{}, free_{}, g_{}, r_{}, scratch_{}, mutants_{},
+          clones_{}, pure_{}, progeny_{}, cloned_{}, buffer_{}, counts_{},
+          hashes_{}, step_(nullptr), deadline_{}, on_best_{},
+          progress_(nullptr) {
+        select_step();
+        const auto seed = problem_->env()->seed();
+        envs_.reserve(pool_->size() + 1u);
+        contexts_.reserve(pool_->size());
+        envs_.push_back(std::make_unique<Environment>(
+            seed, problem_->env()->split(1u)));
+        env_ = envs_.back().get();
+        for (auto i = 0u; i < pool_->size(); ++i) {
+            envs_.push_back(std::make_unique<Environment>(seed));
+            contexts_.push_back(problem_->context(envs_.back().get()));
+        }
+    }
     Solver(const Solver &) = delete;
     Solver &operator=(const Solver &) = delete;
+    Solver(Solver &&) = default;
+    const Parameters &parameters() const { return params_; }
+    /*
+     * Advances the population, of `np` individuals, by one generation. The
+     * population must be sorted by decreasing size and is left that way.
+     */
+    void evolve(Population *population) { (this->*step_)(population); }
+    /*
+     * Makes `solve` return the best solution so far instead of starting a
+     * generation which, if it took as long as the one before it, would end
+     * after deadline. The clock is read once per generation.
+     */
+    void set_deadline(const Deadline &deadline) { deadline_ = deadline; }
+    /*
+     * Makes `solve` call on_best with the best solution each time it
+     * improves, and once with the initial best.
+     */
+    void set_on_best(BestCallback on_best) { on_best_ = std::move(on_best); }
+    /*
+     * Makes `solve` publish its progress to progress after every generation,
+     * and return the best solution so far once progress is cancelled.
+     */
+    void set_progress(Progress *progress) { progress_ = progress; }
     Solution
-    solve(std::array<std::unique_ptr<Solution>, NP> *population,
-          std::uint32_t *gen = nullptr,
-          std::vector<std::uint32_t> *blocks_over_time = nullptr) const {
+    solve(Population *population, std::uint32_t *gen = nullptr,
+          std::vector<std::uint32_t> *blocks_over_time = nullptr) {
         Solution best_solution(*(*population)[0]);
         auto generation = std::uint32_t{};
         auto previous = best_solution.size();
         auto delta_counter = std::uint32_t{};
+        const auto timed = !deadline_.none();
+        auto last = Deadline::Clock::time_point{};
+        auto step = Deadline::Clock::duration::zero();
+
+        if (on_best_) {
+            on_best_(best_solution, generation);
+        }
+        if (progress_) {
+            progress_->reset(best_solution.size());
+        }
 
-        for (; generation < NG &&
+        for (; generation < params_.ng &&
                problem_->bin_count() - best_solution.size() >
                    problem_->lower_bound() &&
-               delta_counter < DL;
+               delta_counter < params_.dl;
              ++generation) {
-            std::array<Solution *, NC / 2u> g;
-            std::array<Solution *, NC / 2u> r;
-            controlled_selection_crossover<NP, NC, NE>(problem_, population, &g,
-                                                       &r);
-            std::array<std::unique_ptr<Solution>, NC> progeny;
-
-            for (auto i = 0u; i < NC / 2u; ++i) {
-                progeny[i] = gene_level_crossover<true>(problem_, *g[i], *r[i]);
-                progeny[i + NC / 2u] =
-                    gene_level_crossover<true>(problem_, *r[i], *g[i]);
+            if (progress_ && progress_->cancelled()) {
+                break;
             }
-
-            controlled_replacement_crossover<NP, NC, NE>(population, &progeny,
-                                                         &r);
-
-            std::vector<Solution *> clones;
-            clones.reserve(NE);
-            std::array<Solution *, NM> mutants;
-
-            controlled_selection_mutation<NP, NM, NE, LS>(*population, &clones,
-                                                          &mutants);
-
-            std::sort(clones.begin(), clones.end());
-            std::sort(mutants.begin(), mutants.end());
-
-            std::vector<Solution *> pure;
-            pure.reserve(mutants.size());
-
-            std::set_difference(mutants.begin(), mutants.end(), clones.begin(),
-                                clones.end(), std::back_inserter(pure));
-
-            std::vector<std::unique_ptr<Solution>> cloned;
-            cloned.reserve(clones.size());
-
-            std::transform(clones.begin(), clones.end(),
-                           std::back_inserter(cloned), [](const Solution *sol) {
-                               return std::make_unique<Solution>(*sol);
-                           });
-
-            for (auto &sol : pure) {
-                adaptive_mutation<k1::num, k1::den, true>(problem_, sol);
+            if (timed) {
+                const auto now = Deadline::Clock::now();
+                if (generation) {
+                    step = now - last;
+                }
+                last = now;
+                if (deadline_.passed(now, step)) {
+                    break;
+                }
             }
 
-            for (auto &sol : clones) {
-                adaptive_mutation<k2::num, k2::den, true>(problem_, sol);
-            }
-
-            std::sort(population->begin(), population->end(),
-                      [](const auto &left, const auto &right) {
-                          return left->size() > right->size();
-                      });
-
-            if (!cloned.empty()) {
-                controlled_replacement_mutation<NP>(population, &cloned);
-            }
+            evolve(population);
 
             const auto &current_best = (*population)[0];
 
             if (current_best->size() > best_solution.size()) {
                 best_solution = *current_best;
+                if (on_best_) {
+                    on_best_(best_solution, generation + 1u);
+                }
             }
 
-            if (previous == best_solution.size()) {
-                ++delta_counter;
-            } else {
+            const auto improved = previous != best_solution.size();
+            if (improved) {
                 previous = best_solution.size();
                 delta_counter = 0u;
+            } else {
+                ++delta_counter;
             }
 
-            for (auto i = 0u; i < NE; i++) {
-                (*population)[i]->increase_age();
+            if (progress_) {
+                progress_->update(generation + 1u, previous, improved);
             }
 
             if (blocks_over_time) {
@@ -0,0 +1,122 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace optimizer {
+
+/*
+ * A fixed set of worker threads executing parallel loops. Indices of a loop
+ * are handed out one at a time from a shared counter, so a worker which
+ * finishes early keeps taking work until the loop is exhausted. The calling
+ * thread takes part in every loop.
+ */
+class ThreadPool {
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::function<void(std::uint32_t)> task_;
+    std::atomic<std::uint32_t> next_;
+    std::uint32_t count_;
+    std::uint32_t busy_;
+    std::uint64_t round_;
+    bool stop_;
+
+    void drain() {
+        for (auto i = next_.fetch_add(1u); i < count_;
+             i = next_.fetch_add(1u)) {
+            task_(i);
+        }
+    }
+
+    void work() {
+        auto seen = std::uint64_t{};
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                wake_.wait(lock,
+                           [this, seen] { return stop_ || round_ != seen; });
+                if (stop_) {
+                    return;
+                }
+                seen = round_;
+                ++busy_;
+            }
+            drain();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--busy_ == 0u) {
+                    done_.notify_one();
+                }
+            }
+        }
+    }
+
+ public:
+    /*
+     * Creates a pool which runs loops on `threads` threads in total, including
+     * the calling thread. A value of 0 selects the hardware concurrency.
+     */
+    explicit ThreadPool(std::uint32_t threads = 0u)
+        : workers_{}, mutex_{}, wake_{}, done_{}, task_{}, next_{}, count_{},
+          busy_{}, round_{}, stop_{} {
+        if (!threads) {
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        workers_.reserve(threads - 1u);
+        for (auto i = 1u; i < threads; ++i) {
+            workers_.emplace_back([this] { work(); });
+        }
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &worker : workers_) {
+            worker.join();
+        }
+    }
+    std::uint32_t size() const { return workers_.size() + 1u; }
+    /*
+     * Calls f(i) for every i in [0, n) and returns once all calls are done.
+     * Must not be called from within f.
+     */
+    template <class F> void parallel_for(std::uint32_t n, F &&f) {
+        if (n <= 1u || workers_.empty()) {
+            for (auto i = 0u; i < n; ++i) {
+                f(i);
+            }
+            return;
+        }
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // a worker may still be leaving the previous loop
+            done_.wait(lock, [this] { return busy_ == 0u; });
+            task_ = std::ref(f);
+            count_ = n;
+            next_.store(0u);
+            ++round_;
+        }
+        wake_.notify_all();
+        drain();
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return busy_ == 0u; });
+        task_ = nullptr;
+    }
+};
+
+} // namespace optimizer
+
+#endif
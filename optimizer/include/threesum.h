@@ -1,11 +1,17 @@
 #ifndef THREESUM_H_
 #define THREESUM_H_
 
+#include <algorithm>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <numeric>
 #include <vector>
 
 #include "item.h"
+#include "thread_pool.h"
 
 #ifdef __GNUC__
 #define likely(x) __builtin_expect(!!(x), 1)
@@ -18,63 +24,251 @@
 namespace optimizer {
 
 /*
- * A 3-Partition of an integer.
+ * A 3-Partition of an integer, given by the indices of its three parts in an
+ * array of items. The indices are packed into 21 bits each.
  */
 class Partition {
-    std::array<ItemCount *, 3u> items_;
+    std::uint64_t bits_;
 
  public:
-    constexpr Partition(ItemCount *a, ItemCount *b, ItemCount *c)
-        : items_{{a, b, c}} {}
-    constexpr const std::array<ItemCount *, 3u> &items() const {
-        return items_;
+    typedef std::array<std::uint32_t, 3u> Items;
+    static constexpr std::uint32_t index_bits = 21u;
+    /*
+     * Indices must be smaller than this.
+     */
+    static constexpr std::uint32_t max_items = 1u << index_bits;
+
+    constexpr Partition(std::uint32_t a, std::uint32_t b, std::uint32_t c)
+        : bits_{a | static_cast<std::uint64_t>(b) << index_bits |
+                static_cast<std::uint64_t>(c) << 2u * index_bits} {}
+    constexpr Items items() const {
+        return {{static_cast<std::uint32_t>(bits_ & (max_items - 1u)),
+                 static_cast<std::uint32_t>(bits_ >> index_bits &
+                                            (max_items - 1u)),
+                 static_cast<std::uint32_t>(bits_ >> 2u * index_bits)}};
     }
 };
 
 /*
- * Computes the possible 3-partitions of a number indicating bin capacity.
+ * Enumerates the 3-partitions of a number over the sizes of a range of items,
+ * which must be unique and sorted in decreasing order. Partitions refer to
+ * items by their index in the range. The sizes are copied to a plain array,
+ * and if they are dense enough, a table from size to index finds the second
+ * part of a partition directly instead of by a two-pointer search.
+ *
+ * Partitions are grouped by their last part, the one with the largest index,
+ * so they can also be produced one last part at a time instead of all at once.
  */
-template <class RandIt, class T>
-constexpr void threesum(RandIt begin, RandIt end, T *out,
-                        std::uint32_t bin_count, std::uint32_t capacity) {
-    const auto r = bin_count * capacity;
+class ThreeSum {
+    std::vector<std::uint32_t> sizes_;
+    std::vector<std::uint32_t> index_;
+
+    /*
+     * Calls f(a, b, e) for the partitions of r whose last part e has an index
+     * in the range from lo to hi, in decreasing order of e.
+     */
+    template <class F>
+    void enumerate(std::uint32_t r, std::uint32_t lo, std::uint32_t hi,
+                   F &&f) const {
+        auto a = first(r, hi);
 
-    if(!r || begin == end) {
-        return;
+        for (auto e = hi + 1u; e-- > lo;) {
+            while (a <= e && sizes_[a] + 2u * sizes_[e] > r) {
+                ++a;
+            }
+            if (a > e) {
+                return;
+            }
+            pairs(r, e, a, [&f, e](std::uint32_t p_a, std::uint32_t p_b) {
+                f(p_a, p_b, e);
+                return false;
+            });
+        }
     }
 
-    --end;
+ public:
+    /*
+     * Sizes up to this multiple of the number of items get a lookup table.
+     */
+    static constexpr std::uint32_t density = 64u;
+    /*
+     * Ranges with at least this many items are split over threads.
+     */
+    static constexpr std::uint32_t parallel_threshold = 4096u;
 
-    while (end->size + 2u * begin->size < r) {
-        if (--end < begin) {
-            return;
+    ThreeSum() : sizes_{}, index_{} {}
+    template <class InputIt>
+    ThreeSum(InputIt begin, InputIt end) : sizes_{}, index_{} {
+        sizes_.reserve(std::distance(begin, end));
+        for (; begin != end; ++begin) {
+            sizes_.push_back(begin->size);
+        }
+        if (!sizes_.empty() && sizes_.front() / density < sizes_.size()) {
+            index_.assign(sizes_.front() + 1u,
+                          std::numeric_limits<std::uint32_t>::max());
+            for (auto i = 0u; i < sizes_.size(); ++i) {
+                index_[sizes_[i]] = i;
+            }
         }
     }
+    /*
+     * Returns the number of indices, counted from 0, which may be the last
+     * part of a partition of r.
+     */
+    std::uint32_t ends(std::uint32_t r) const {
+        if (!r || sizes_.empty()) {
+            return 0u;
+        }
+        // the last part must leave room for two parts of at most sizes_[0]
+        return std::partition_point(sizes_.cbegin(), sizes_.cend(),
+                                    [r, s = sizes_.front()](std::uint32_t x) {
+                                        return x + 2u * s >= r;
+                                    }) -
+               sizes_.cbegin();
+    }
+    /*
+     * Returns the smallest index which may be the first part of a partition
+     * of r with last part e. If it is larger than e, there is none.
+     */
+    std::uint32_t first(std::uint32_t r, std::uint32_t e) const {
+        // the first part must leave room for two parts of size sizes_[e]
+        return std::partition_point(sizes_.cbegin(), sizes_.cbegin() + e + 1u,
+                                    [r, s = sizes_[e]](std::uint32_t x) {
+                                        return x + 2u * s > r;
+                                    }) -
+               sizes_.cbegin();
+    }
+    /*
+     * Calls f(a, b) in increasing order of a for the partitions (a, b, e) of
+     * r with a at least first(r, e), which must not exceed e, until f returns
+     * `true`.
+     */
+    template <class F>
+    void pairs(std::uint32_t r, std::uint32_t e, std::uint32_t a,
+               F &&f) const {
+        const auto sizes = sizes_.data();
+        const auto target = r - sizes[e];
 
-    for (; begin <= end; --end) {
-        while (begin->size + 2u * end->size > r) {
-            if (++begin > end) {
-                return;
+        if (!index_.empty()) {
+            const auto none = std::numeric_limits<std::uint32_t>::max();
+            for (; a <= e && 2u * sizes[a] >= target; ++a) {
+                const auto b = index_[target - sizes[a]];
+                if (unlikely(b != none) && f(a, b)) {
+                    return;
+                }
             }
+            return;
         }
 
-        auto p_a = begin;
-        auto p_b = end;
-        const auto target = r - end->size;
+        auto b = e;
 
         do {
-            const auto t = p_a->size + p_b->size;
+            const auto t = sizes[a] + sizes[b];
             if (t < target) {
-                --p_b;
+                --b;
             } else {
-                if (unlikely(t == target)) {
-                    out->emplace_back(&*p_a, &*p_b, &*end);
+                if (unlikely(t == target) && f(a, b)) {
+                    return;
                 }
-                ++p_a;
+                ++a;
             }
-        } while (p_a <= p_b);
+        } while (a <= b);
+    }
+    /*
+     * Returns the number of 3-partitions of r.
+     */
+    std::uint64_t count(std::uint32_t r) const {
+        auto result = std::uint64_t{};
+        const auto n = ends(r);
+        if (n) {
+            enumerate(r, 0u, n - 1u,
+                      [&result](std::uint32_t, std::uint32_t, std::uint32_t) {
+                          ++result;
+                      });
+        }
+        return result;
+    }
+    /*
+     * Writes the number of 3-partitions of r with last part e to out[e], for
+     * each e below ends(r). If a pool is given and there are many items,
+     * ranges of the last part are counted on its threads.
+     */
+    void count(std::uint32_t r, std::uint32_t *out,
+               ThreadPool *pool = nullptr) const {
+        const auto n = ends(r);
+        const auto tally = [this, r, out](std::uint32_t lo, std::uint32_t hi) {
+            enumerate(r, lo, hi,
+                      [out](std::uint32_t, std::uint32_t, std::uint32_t e) {
+                          ++out[e];
+                      });
+        };
+
+        std::fill_n(out, n, 0u);
+        if (!n) {
+            return;
+        }
+
+        if (!pool || pool->size() == 1u || sizes_.size() < parallel_threshold) {
+            tally(0u, n - 1u);
+            return;
+        }
+
+        const auto chunks = std::min(n, 8u * pool->size());
+        pool->parallel_for(chunks, [n, chunks, &tally](std::uint32_t k) {
+            const auto bound = [n, chunks](std::uint32_t i) {
+                return static_cast<std::uint32_t>(
+                    n - static_cast<std::uint64_t>(n) * i / chunks);
+            };
+            tally(bound(k + 1u), bound(k) - 1u);
+        });
     }
-}
+    /*
+     * Appends the 3-partitions of r to out, ordered by decreasing index of the
+     * last part and then by increasing index of the first part. If a pool is
+     * given and there are many items, ranges of the last part are enumerated
+     * on its threads and concatenated in order.
+     */
+    template <class T>
+    void operator()(T *out, std::uint32_t r, ThreadPool *pool = nullptr) const {
+        const auto n = ends(r);
+
+        if (!n) {
+            return;
+        }
+
+        if (!pool || pool->size() == 1u || sizes_.size() < parallel_threshold) {
+            enumerate(r, 0u, n - 1u,
+                      [out](std::uint32_t a, std::uint32_t b, std::uint32_t e) {
+                          out->emplace_back(a, b, e);
+                      });
+            return;
+        }
+
+        const auto chunks = std::min(n, 8u * pool->size());
+        std::vector<T> parts(chunks);
+        pool->parallel_for(chunks, [this, r, n, chunks,
+                                    &parts](std::uint32_t k) {
+            // chunk k takes the k-th range of last parts from the top
+            const auto bound = [n, chunks](std::uint32_t i) {
+                return static_cast<std::uint32_t>(
+                    n - static_cast<std::uint64_t>(n) * i / chunks);
+            };
+            auto &part = parts[k];
+            enumerate(r, bound(k + 1u), bound(k) - 1u,
+                      [&part](std::uint32_t a, std::uint32_t b,
+                              std::uint32_t e) { part.emplace_back(a, b, e); });
+        });
+
+        auto total = out->size();
+        for (const auto &part : parts) {
+            total += part.size();
+        }
+        out->reserve(total);
+        for (const auto &part : parts) {
+            out->insert(out->end(), part.cbegin(), part.cend());
+        }
+    }
+};
 
 } // namespace optimizer
 
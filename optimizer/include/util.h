@@ -1,11 +1,18 @@
 #ifndef UTIL_H_
 #define UTIL_H_
 
+#include <assert.h>
+
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
 #include <limits>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <type_traits>
+#include <vector>
 
 namespace optimizer {
 
@@ -43,6 +50,59 @@ constexpr ForwardIt dedup(ForwardIt first, ForwardIt last, Count count,
     return ++result;
 }
 
+/*
+ * Same as std::inplace_merge, but uses the range starting at buffer, which
+ * must be able to hold the whole range from first to last, instead of
+ * allocating temporary storage.
+ */
+template <class RandIt, class BufferIt, class Compare>
+void inplace_merge(RandIt first, RandIt middle, RandIt last, BufferIt buffer,
+                   Compare comp) {
+    const auto end = std::merge(
+        std::make_move_iterator(first), std::make_move_iterator(middle),
+        std::make_move_iterator(middle), std::make_move_iterator(last), buffer,
+        comp);
+    std::move(buffer, end, first);
+}
+
+/*
+ * Sorts the range from first to last by decreasing key, keeping the order of
+ * elements with equal keys, in time linear in the length of the range and in
+ * the difference between its largest and smallest keys. Uses counts and the
+ * range starting at buffer, which must be able to hold the whole range from
+ * first to last, as temporary storage.
+ */
+template <class RandIt, class BufferIt, class Key>
+void counting_sort(RandIt first, RandIt last, BufferIt buffer, Key key,
+                   std::vector<std::uint32_t> *counts) {
+    if (last - first < 2) {
+        return;
+    }
+
+    std::uint32_t low = key(*first);
+    auto high = low;
+    for (auto it = first + 1; it != last; ++it) {
+        const std::uint32_t k = key(*it);
+        low = std::min(low, k);
+        high = std::max(high, k);
+    }
+
+    if (low == high) {
+        return;
+    }
+
+    // the elements with key k go from offset (*counts)[high - k] onwards
+    counts->assign(high - low + 2u, 0u);
+    for (auto it = first; it != last; ++it) {
+        ++(*counts)[high - key(*it) + 1u];
+    }
+    std::partial_sum(counts->begin(), counts->end(), counts->begin());
+    for (auto it = first; it != last; ++it) {
+        buffer[(*counts)[high - key(*it)]++] = std::move(*it);
+    }
+    std::move(buffer, buffer + (last - first), first);
+}
+
 /*
  * Frequency counter for sorted ranges of items.
  *
@@ -65,6 +125,53 @@ std::vector<ItemCount> fcount(RandIt begin, RandIt end) {
     return result;
 }
 
+/*
+ * Adds the items in the range from begin to end, none of them larger than
+ * max, to histogram, which holds the count of each item at its index.
+ */
+template <class InputIt>
+void histogram_add(InputIt begin, InputIt end, std::uint32_t max,
+                   std::uint32_t *histogram) {
+    for (; begin != end; ++begin) {
+        assert(*begin <= max && "bad item");
+        ++histogram[*begin];
+    }
+}
+
+/*
+ * Collects the items counted in the histogram of the given size.
+ *
+ * Output std::vector<ItemCount> of unique items and counts, in decreasing
+ * order of the items.
+ */
+inline std::vector<ItemCount> histogram_counts(const std::uint32_t *histogram,
+                                               std::size_t size) {
+    std::vector<ItemCount> result;
+    for (auto item = size; item-- > 0u;) {
+        if (histogram[item]) {
+            result.emplace_back(item, histogram[item]);
+        }
+    }
+    result.shrink_to_fit();
+    return result;
+}
+
+/*
+ * Frequency counter for unsorted ranges of items, using a histogram. Reads
+ * the range once, so it can be a stream.
+ *
+ * Input range of items and max, the largest item it may contain.
+ *
+ * Output std::vector<ItemCount> of unique items and counts, in decreasing
+ * order of the items.
+ */
+template <class InputIt>
+std::vector<ItemCount> hcount(InputIt begin, InputIt end, std::uint32_t max) {
+    std::vector<std::uint32_t> histogram(std::size_t{max} + 1u);
+    histogram_add(begin, end, max, histogram.data());
+    return histogram_counts(histogram.data(), histogram.size());
+}
+
 /*
  * Generates a bounded uniform random variate.
  */
@@ -85,6 +192,89 @@ constexpr std::uint32_t bounded_rand(std::uint32_t n, Rng &&gen) {
     return static_cast<std::uint32_t>(p >> 32u);
 }
 
+/*
+ * Generates a bounded uniform random variate for bounds beyond the range of
+ * gen, from two of its outputs at a time.
+ */
+template <typename Rng>
+constexpr std::uint64_t bounded_rand64(std::uint64_t n, Rng &&gen) {
+    if (n <= std::numeric_limits<std::uint32_t>::max()) {
+        return bounded_rand(static_cast<std::uint32_t>(n), gen);
+    }
+    const auto t = -n % n;
+    auto x = std::uint64_t{};
+    do {
+        x = static_cast<std::uint64_t>(gen()) << 32u | gen();
+    } while (x < t);
+    return x % n;
+}
+
+/*
+ * A Fenwick tree over the weights of the indices below n, from which an index
+ * is drawn with probability proportional to its weight. Each draw or change
+ * of a weight takes O(log n).
+ */
+class WeightTree {
+    std::vector<std::uint64_t> tree_;
+    std::uint32_t mask_;
+
+ public:
+    WeightTree() : tree_{}, mask_{} {}
+    /*
+     * Sets the weight of i to weight(i), for each i below n.
+     */
+    template <class Weight> void assign(std::uint32_t n, Weight &&weight) {
+        mask_ = 1u;
+        while (mask_ < n) {
+            mask_ <<= 1u;
+        }
+        tree_.assign(mask_ + 1u, 0u);
+        for (auto i = 1u; i <= mask_; ++i) {
+            if (i <= n) {
+                tree_[i] += weight(i - 1u);
+            }
+            const auto parent = i + (i & (0u - i));
+            if (parent <= mask_) {
+                tree_[parent] += tree_[i];
+            }
+        }
+    }
+    std::uint64_t total() const { return tree_.empty() ? 0u : tree_[mask_]; }
+    std::uint64_t weight(std::uint32_t i) const {
+        const auto node = i + 1u;
+        const auto parent = node - (node & (0u - node));
+        auto result = tree_[node];
+        for (auto j = i; j > parent; j -= j & (0u - j)) {
+            result -= tree_[j];
+        }
+        return result;
+    }
+    /*
+     * Returns the index under offset r of the weights laid end to end in
+     * increasing order of index, and makes r the offset into its weight. The
+     * offset must be below total().
+     */
+    std::uint32_t find(std::uint64_t *r) const {
+        auto pos = 0u;
+        for (auto step = mask_; step; step >>= 1u) {
+            const auto next = pos + step;
+            if (tree_[next] <= *r) {
+                *r -= tree_[next];
+                pos = next;
+            }
+        }
+        return pos;
+    }
+    /*
+     * Lowers the weight of i by d.
+     */
+    void lower(std::uint32_t i, std::uint64_t d) {
+        for (auto j = i + 1u; j <= mask_; j += j & (0u - j)) {
+            tree_[j] -= d;
+        }
+    }
+};
+
 /*
  * Similar to std::partition and std::shuffle. Randomly moves n elements
  * in order to the beginning of the range.
@@ -109,20 +299,158 @@ constexpr RandIt sample_inplace(RandIt begin, RandIt end, Count n, Rng &&gen) {
 }
 
 /*
- *  Reimplementation of std::shuffle.
+ * Draws the elements of a multiset in random order, without replacement,
+ * from a Fenwick tree over the counts of its distinct elements, so the
+ * order is never stored. Each draw takes O(log n) for n distinct elements.
+ */
+class CountSampler {
+    std::vector<std::uint32_t> tree_;
+    std::uint32_t mask_;
+
+ public:
+    CountSampler() : tree_{}, mask_{} {}
+    /*
+     * Sets the multiset to count(i) copies of i, for each i below n.
+     */
+    template <class Count> void assign(std::uint32_t n, Count &&count) {
+        mask_ = 1u;
+        while (mask_ < n) {
+            mask_ <<= 1u;
+        }
+        tree_.assign(mask_ + 1u, 0u);
+        for (auto i = 1u; i <= mask_; ++i) {
+            if (i <= n) {
+                tree_[i] += count(i - 1u);
+            }
+            const auto parent = i + (i & (0u - i));
+            if (parent <= mask_) {
+                tree_[parent] += tree_[i];
+            }
+        }
+    }
+    /*
+     * Removes the element at offset r among the remaining elements, in
+     * increasing order, and returns it.
+     */
+    std::uint32_t take(std::uint32_t r) {
+        auto pos = 0u;
+        for (auto step = mask_; step; step >>= 1u) {
+            const auto next = pos + step;
+            const auto skip = tree_[next] <= r;
+            r -= skip ? tree_[next] : 0u;
+            pos = skip ? next : pos;
+        }
+        for (auto i = pos + 1u; i <= mask_; i += i & (0u - i)) {
+            --tree_[i];
+        }
+        return pos;
+    }
+};
+
+/*
+ * Generates two bounded uniform random variates from a single output of gen,
+ * the first below n and the second below n - 1, as needed by two steps of a
+ * shuffle. The product n * (n - 1) must not exceed the range of gen. The
+ * second variate is written to second.
+ */
+template <typename Rng>
+constexpr std::uint32_t bounded_rand2(std::uint32_t n, Rng &&gen,
+                                      std::uint32_t *second) {
+    const auto product = n * (n - 1u);
+    auto p = static_cast<std::uint64_t>(gen()) * n;
+    auto q = static_cast<std::uint64_t>(static_cast<std::uint32_t>(p)) *
+             (n - 1u);
+    if (static_cast<std::uint32_t>(q) < product) {
+        const auto t = -product % product;
+        while (static_cast<std::uint32_t>(q) < t) {
+            p = static_cast<std::uint64_t>(gen()) * n;
+            q = static_cast<std::uint64_t>(static_cast<std::uint32_t>(p)) *
+                (n - 1u);
+        }
+    }
+    *second = static_cast<std::uint32_t>(q >> 32u);
+    return static_cast<std::uint32_t>(p >> 32u);
+}
+
+/*
+ * Reimplementation of std::shuffle. Once fewer than 2^16 elements remain,
+ * every output of gen yields two swaps.
  */
 template <typename RandIt, typename Rng>
-constexpr void shuffle(RandIt begin, RandIt end, Rng &&gen) {
+constexpr void fisher_yates(RandIt begin, RandIt end, Rng &&gen) {
     typedef typename std::iterator_traits<RandIt>::difference_type delta_t;
     typedef typename std::remove_reference<Rng>::type::result_type result_t;
     static_assert(std::is_same<std::uint32_t, result_t>::value, "Wrong type");
+    using std::swap;
     auto count = std::distance(begin, end);
-    while (count > typename std::iterator_traits<RandIt>::difference_type(1)) {
+    for (; count > delta_t(1u << 16u); --count) {
         const auto chosen = static_cast<delta_t>(
-            bounded_rand(static_cast<result_t>(count--), gen));
-        using std::swap;
+            bounded_rand(static_cast<result_t>(count), gen));
         swap(*(begin + chosen), *--end);
     }
+    for (; count > delta_t(2); count -= 2) {
+        auto second = result_t{};
+        const auto first = static_cast<delta_t>(
+            bounded_rand2(static_cast<result_t>(count), gen, &second));
+        swap(*(begin + first), *--end);
+        swap(*(begin + static_cast<delta_t>(second)), *--end);
+    }
+    if (count == delta_t(2) && (gen() & 1u)) {
+        swap(*begin, *(begin + 1));
+    }
+}
+
+/*
+ * The number of elements up to which `shuffle` swaps at random positions
+ * directly. Larger ranges are first dealt into 256 buckets at random, which
+ * are small enough to be shuffled in cache.
+ */
+constexpr std::uint32_t shuffle_block = 1u << 22u;
+
+/*
+ * Shuffles the range from begin to end uniformly at random, with the
+ * Fisher-Yates shuffle for small ranges and the method of Rao and Sandelius
+ * for large ones: every element goes to a bucket drawn at random, and the
+ * buckets are shuffled one after another. For a given state of gen, the
+ * result depends on the range only.
+ */
+template <typename RandIt, typename Rng>
+void shuffle(RandIt begin, RandIt end, Rng &&gen) {
+    typedef typename std::iterator_traits<RandIt>::difference_type delta_t;
+    typedef typename std::iterator_traits<RandIt>::value_type value_t;
+    const auto count = std::distance(begin, end);
+    if (count <= delta_t(shuffle_block)) {
+        fisher_yates(begin, end, gen);
+        return;
+    }
+
+    // a byte of output per element picks its bucket; the buckets are drawn
+    // twice, to count and to deal the elements, from the same state of gen
+    auto replay = gen;
+    std::vector<delta_t> offsets(257u);
+    for (auto it = begin; it != end;) {
+        auto bits = gen();
+        for (auto k = 0u; k < 4u && it != end; ++k, ++it, bits >>= 8u) {
+            ++offsets[(bits & 0xffu) + 1u];
+        }
+    }
+    std::partial_sum(offsets.cbegin(), offsets.cend(), offsets.begin());
+
+    std::unique_ptr<value_t[]> buffer(new value_t[count]);
+    auto heads(offsets);
+    for (auto it = begin; it != end;) {
+        auto bits = replay();
+        for (auto k = 0u; k < 4u && it != end; ++k, ++it, bits >>= 8u) {
+            buffer[heads[bits & 0xffu]++] = std::move(*it);
+        }
+    }
+
+    for (auto i = 0u; i < 256u; ++i) {
+        const auto first = buffer.get() + offsets[i];
+        const auto last = buffer.get() + offsets[i + 1u];
+        optimizer::shuffle(first, last, gen);
+        std::move(first, last, begin + offsets[i]);
+    }
 }
 
 } // namespace optimizer
@@ -1,7 +1,6 @@
 #include <assert.h>
 
 #include <algorithm>
-#include <array>
 #include <chrono>
 #include <cstdlib>
 #include <iostream>
@@ -9,14 +8,18 @@
 #include <memory>
 #include <numeric>
 #include <random>
+#include <thread>
 #include <vector>
 
+#include "bound_refiner.h"
 #include "environment.h"
+#include "islands.h"
+#include "parameters.h"
+#include "population.h"
 #include "problem.h"
 #include "solution.h"
 #include "solver.h"
-
-const std::uint32_t POPULATION_SIZE = 100;
+#include "thread_pool.h"
 
 int main(int argc, char **argv) {
     if (argc < 3) {
@@ -24,7 +27,7 @@ int main(int argc, char **argv) {
         return -1;
     }
 
-    if (argc > 3) {
+    if (argc > 6) {
         std::cerr << "Too many arguments.\n";
         return -1;
     }
@@ -43,14 +46,37 @@ int main(int argc, char **argv) {
         return -1;
     }
 
+    auto island_count = argc > 3 ? std::strtoul(argv[3], nullptr, 0) : 1ul;
+
+    if (!island_count) {
+        std::cerr << "Bad number of islands.\n";
+        return -1;
+    }
+
     std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
     optimizer::Environment env;
+    // a run is replayed by passing the seed it printed
+    if (argc > 4) {
+        env.reseed(std::strtoull(argv[4], nullptr, 0));
+    }
     std::cout << "Seed: " << env.seed() << '\n';
 
+    // the refiner raises the lower bound, which decides when a run stops and
+    // how far mutation goes, at times which depend on the threads, so runs
+    // which refine it can not be replayed
+    const auto refine_rounds =
+        argc > 5 ? std::strtoul(argv[5], nullptr, 0) : 0ul;
+    if (refine_rounds) {
+        std::cout << "Refining the lower bound, the run can not be replayed\n";
+    }
+
     std::uniform_int_distribution<std::uint32_t> size_dist(1, bin_capacity);
 
-    std::array<std::unique_ptr<optimizer::Solution>, POPULATION_SIZE>
-        population;
+    const optimizer::Parameters params{};
+    std::vector<optimizer::Population> islands(island_count);
+    for (auto &population : islands) {
+        population.resize(params.np);
+    }
 
     std::vector<std::uint32_t> item_sizes;
     item_sizes.reserve(item_count);
@@ -64,60 +90,79 @@ int main(int argc, char **argv) {
     optimizer::Solution best_solution;
     auto gen = std::uint32_t{};
 
+    optimizer::ThreadPool pool;
+
     start = std::chrono::high_resolution_clock::now();
 
     optimizer::Problem problem(&env, item_sizes.cbegin(), item_sizes.cend(),
-                               bin_capacity);
+                               bin_capacity, 0u, &pool);
+
+    auto context = problem.context();
 
     if (!problem.solved()) {
+        // if asked to, a spare core keeps tightening the lower bound during
+        // the search
+        optimizer::BoundRefiner refiner(
+            &problem, {},
+            std::thread::hardware_concurrency() > 1u ? refine_rounds : 0u);
         auto found_optimal = false;
 
-        for (auto i = 0u; i < population.size(); ++i) {
-            population[i] = problem.generate_individual();
+        for (auto it = islands.begin(); it != islands.end() && !found_optimal;
+             ++it) {
+            auto &population = *it;
+            const auto i = optimizer::generate_population(problem, &pool,
+                                                          &population);
 
-            if (problem.bin_count() - population[i]->size() ==
-                problem.lower_bound()) {
+            if (i < population.size()) {
                 best_solution = std::move(*population[i]);
                 found_optimal = true;
-                break;
+            } else {
+                std::sort(population.begin(), population.end(),
+                          [](const std::unique_ptr<optimizer::Solution> &l,
+                             const std::unique_ptr<optimizer::Solution> &r) {
+                              return l->size() > r->size();
+                          });
             }
         }
 
-        if (!found_optimal) {
-            std::sort(population.begin(), population.end(),
-                      [](const std::unique_ptr<optimizer::Solution> &l,
-                         const std::unique_ptr<optimizer::Solution> &r) {
-                          return l->size() > r->size();
-                      });
-            best_solution = optimizer::Solver<POPULATION_SIZE>(&problem).solve(
-                &population, &gen);
+        if (!found_optimal && islands.size() == 1u) {
+            best_solution =
+                optimizer::Solver(&problem, &pool, params)
+                    .solve(&islands[0], &gen);
+        } else if (!found_optimal) {
+            best_solution =
+                optimizer::IslandSolver(&problem, &pool, params)
+                    .solve(&islands, &gen);
         }
     } else {
         if (problem.bin_count() >= problem.item_count()) {
             best_solution.items().reserve(problem.item_count());
             best_solution.blocks().reserve(problem.bin_count());
-            for (auto &v : problem.items()) {
-                std::fill_n(std::back_inserter(best_solution.items()), v.count,
-                            &v);
+            for (auto i = 0u; i < problem.items().size(); ++i) {
+                std::fill_n(std::back_inserter(best_solution.items()),
+                            problem.items()[i].count, i);
             }
-            for (auto it = best_solution.items().begin();
-                 it != best_solution.items().end(); ++it) {
-                best_solution.blocks().emplace_back(it, it, 1u, 0u);
-                best_solution.blocks().back().put(*it, problem.bin_capacity());
+            const auto n =
+                static_cast<std::uint32_t>(best_solution.items().size());
+            for (auto i = 0u; i < n; ++i) {
+                best_solution.blocks().emplace_back(i, i, 1u, 0u,
+                                                    problem.bin_capacity());
+                best_solution.blocks().back().put(
+                    problem.items()[best_solution.items()[i]].size,
+                    problem.bin_capacity());
             }
             std::fill_n(std::back_inserter(best_solution.blocks()),
                         problem.bin_count() - problem.item_count(),
-                        optimizer::Solution::Block(best_solution.items().end(),
-                                                   best_solution.items().end(),
-                                                   1u, 0u));
+                        optimizer::Solution::Block(n, n, 1u, 0u,
+                                                   problem.bin_capacity()));
         } else {
-            best_solution = *problem.generate_individual<false>();
+            best_solution = *problem.generate_individual<false>(&context);
         }
     }
 
     end = std::chrono::high_resolution_clock::now();
 
-    std::cout << best_solution << '\n';
+    std::cout << optimizer::format(best_solution, problem.items()) << '\n';
 
     std::cout << "Generations: " << gen << '\n';
 
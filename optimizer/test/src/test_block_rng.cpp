@@ -0,0 +1,67 @@
+#include <cstdint>
+#include <iostream>
+
+#include <pcg_random.hpp>
+
+#include "block_rng.h"
+#include "environment.h"
+
+/*
+ * Returns the number of outputs of lane i of rng, over blocks blocks, which
+ * differ from those of a scalar `pcg32` seeded as the lane is.
+ */
+static std::uint32_t test_lane(optimizer::BlockRng *rng, std::uint64_t seed,
+                               std::uint64_t stream, std::uint32_t i,
+                               std::uint32_t blocks) {
+    constexpr auto lanes = optimizer::BlockRng::lanes;
+    pcg32 seeder(seed, lanes);
+    seeder.advance(2u * lanes * stream + 2u * i);
+    const auto init = static_cast<std::uint64_t>(seeder()) << 32u | seeder();
+    pcg32 lane(init, i);
+    auto mismatches = 0u;
+    for (auto b = 0u; b < blocks; ++b) {
+        const auto &block = rng->next_block();
+        for (auto j = i; j < optimizer::BlockRng::block_size; j += lanes) {
+            mismatches += block[j] != lane();
+        }
+    }
+    return mismatches;
+}
+
+static std::uint32_t test_lanes(std::uint64_t seed, std::uint64_t stream) {
+    auto mismatches = 0u;
+    for (auto i = 0u; i < optimizer::BlockRng::lanes; ++i) {
+        optimizer::BlockRng rng(seed, stream);
+        mismatches += test_lane(&rng, seed, stream, i, 4u);
+    }
+    return mismatches;
+}
+
+/*
+ * Returns the number of lanes of the generator of an environment reseeded on
+ * sub-stream stream of seed which differ from those of a scalar `pcg32`.
+ */
+static std::uint32_t test_environment(optimizer::Environment *env,
+                                      std::uint64_t seed,
+                                      std::uint64_t stream) {
+    auto mismatches = 0u;
+    for (auto i = 0u; i < optimizer::BlockRng::lanes; ++i) {
+        env->reseed(seed, stream);
+        mismatches += test_lane(env->block_rng(), seed, stream, i, 2u) != 0u;
+    }
+    return mismatches;
+}
+
+int main() {
+    optimizer::Environment env(42u);
+
+    std::cout << test_lanes(0u, 0u) << '\n';
+    std::cout << test_lanes(42u, 0u) << '\n';
+    std::cout << test_lanes(42u, 1u) << '\n';
+    std::cout << test_lanes(0xdeadbeefcafef00du, 12345u) << '\n';
+    std::cout << test_environment(&env, 42u, 0u) << '\n';
+    std::cout << test_environment(&env, 7u, 3u) << '\n';
+    std::cout << test_environment(&env, 42u, 0u) << '\n';
+
+    return 0;
+}
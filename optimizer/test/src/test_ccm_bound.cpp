@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "environment.h"
+#include "item.h"
+#include "lower_bound.h"
+#include "util.h"
+
+typedef std::vector<optimizer::ItemCount> Items;
+
+/*
+ * Returns the least number of bins of capacity c which hold the items
+ * without fragmentation, by trying every bin for every item, largest first.
+ */
+static std::uint32_t optimum(const Items &items, std::uint32_t c) {
+    std::vector<std::uint32_t> sizes;
+    for (const auto &item : items) {
+        sizes.insert(sizes.end(), item.count, item.size);
+    }
+    std::sort(sizes.begin(), sizes.end(), std::greater<std::uint32_t>());
+
+    auto best = static_cast<std::uint32_t>(sizes.size());
+    std::vector<std::uint32_t> loads;
+    std::function<void(std::uint32_t)> place = [&](std::uint32_t i) {
+        if (loads.size() >= best) {
+            return;
+        }
+        if (i == sizes.size()) {
+            best = static_cast<std::uint32_t>(loads.size());
+            return;
+        }
+        for (auto j = 0u; j < loads.size(); ++j) {
+            if (loads[j] + sizes[i] <= c) {
+                loads[j] += sizes[i];
+                place(i + 1u);
+                loads[j] -= sizes[i];
+            }
+        }
+        loads.push_back(sizes[i]);
+        place(i + 1u);
+        loads.pop_back();
+    };
+    place(0u);
+    return best;
+}
+
+static std::uint32_t bound(const Items &items, std::uint32_t c) {
+    return optimizer::ccm_bound(items.cbegin(), items.cend(), c);
+}
+
+/*
+ * Returns the number of random instances of up to 10 items with sizes up to
+ * c for which `ccm_bound` exceeds the optimum, and counts in tight those for
+ * which it meets it.
+ */
+static std::uint32_t test_random(optimizer::Environment *env,
+                                 std::uint32_t instances, std::uint32_t c,
+                                 std::uint32_t *tight) {
+    auto &rng = *env->rng();
+    auto violations = 0u;
+    for (auto i = 0u; i < instances; ++i) {
+        Items items;
+        for (auto k = 1u + optimizer::bounded_rand(10u, rng); k > 0u; --k) {
+            items.emplace_back(1u + optimizer::bounded_rand(c, rng), 1u);
+        }
+        const auto b = bound(items, c);
+        const auto o = optimum(items, c);
+        violations += b > o;
+        *tight += b == o;
+    }
+    return violations;
+}
+
+int main() {
+    optimizer::Environment env(42u);
+
+    for (const auto &items :
+         {Items{{6u, 3u}, {4u, 3u}}, Items{{7u, 2u}, {5u, 2u}, {3u, 2u}},
+          Items{{5u, 5u}, {4u, 1u}}, Items{{9u, 1u}, {6u, 3u}, {4u, 3u}},
+          Items{{3u, 7u}}}) {
+        std::cout << bound(items, 10u) << ' ' << optimum(items, 10u) << '\n';
+    }
+    auto tight = 0u;
+    std::cout << test_random(&env, 1000u, 10u, &tight) << ' ';
+    std::cout << test_random(&env, 1000u, 100u, &tight) << ' ';
+    std::cout << tight << '\n';
+
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "environment.h"
+#include "item.h"
+#include "problem.h"
+#include "thread_pool.h"
+#include "util.h"
+
+/*
+ * Determines if counts are those of sizes, as counted by `fcount` after
+ * sorting them in decreasing order.
+ */
+static bool counts_of(const std::vector<optimizer::ItemCount> &counts,
+                      std::vector<std::uint32_t> sizes) {
+    std::sort(sizes.begin(), sizes.end(), std::greater<std::uint32_t>());
+    const auto expected = optimizer::fcount(sizes.cbegin(), sizes.cend());
+    return std::equal(counts.cbegin(), counts.cend(), expected.cbegin(),
+                      expected.cend(), [](const auto &lhs, const auto &rhs) {
+                          return lhs.size == rhs.size &&
+                                 lhs.count == rhs.count;
+                      });
+}
+
+/*
+ * Returns the number of distinct sizes counted by `hcount`, or 0 if it
+ * disagrees with `fcount`.
+ */
+static std::uint32_t test_hcount(const std::vector<std::uint32_t> &sizes,
+                                 std::uint32_t max) {
+    const auto counts = optimizer::hcount(sizes.cbegin(), sizes.cend(), max);
+    return counts_of(counts, sizes) ? counts.size() : 0u;
+}
+
+/*
+ * Returns the number of distinct sizes counted by `Problem::count_sizes` from
+ * a stream, which is read once, or 0 if it disagrees with `fcount`.
+ */
+static std::uint32_t test_stream(const std::vector<std::uint32_t> &sizes,
+                                 std::uint32_t c) {
+    std::stringstream stream;
+    for (const auto size : sizes) {
+        stream << size << '\n';
+    }
+    std::istream_iterator<std::uint32_t> begin(stream), end;
+    const auto counts = optimizer::Problem::count_sizes(
+        begin, end, c, nullptr, std::input_iterator_tag{});
+    return counts_of(counts, sizes) ? counts.size() : 0u;
+}
+
+/*
+ * Returns the number of distinct sizes counted by `Problem::count_sizes` in
+ * histograms on the threads of pool, or 0 if it disagrees with `fcount`.
+ */
+static std::uint32_t test_parallel(optimizer::ThreadPool *pool,
+                                   const std::vector<std::uint32_t> &sizes,
+                                   std::uint32_t c) {
+    const auto counts = optimizer::Problem::count_sizes(
+        sizes.cbegin(), sizes.cend(), c, pool,
+        std::random_access_iterator_tag{});
+    return counts_of(counts, sizes) ? counts.size() : 0u;
+}
+
+/*
+ * Builds a problem with more distinct sizes than `Problem::parallel_threshold`
+ * both serially and on the threads of pool, most of them pairing up exactly
+ * with another to fill a bin. Prints the bin count, the item count and the
+ * number of distinct sizes left by the serial reductions, and returns whether
+ * the pooled reductions leave the same problem.
+ */
+static bool test_reduction(optimizer::Environment *env,
+                           optimizer::ThreadPool *pool) {
+    // the sizes add up to less than 2^32
+    const auto c = 70000u;
+    const auto n = 34000u;
+    std::vector<optimizer::ItemCount> large, small;
+    for (auto s = 2u; s <= n; ++s) {
+        // a few large sizes and more small ones are left over
+        large.emplace_back(c - s, s % 2000u == 0u ? 2u : 1u);
+        small.emplace_back(s, s % 7u == 0u ? 2u : 1u);
+    }
+    std::vector<optimizer::ItemCount> sizes{{c, 3u}, {c - 1u, 2u}};
+    sizes.insert(sizes.end(), large.cbegin(), large.cend());
+    sizes.emplace_back(c / 2u, 5u);
+    sizes.insert(sizes.end(), small.crbegin(), small.crend());
+
+    const optimizer::Problem serial(env, sizes, c);
+    const optimizer::Problem pooled(env, sizes, c, 0u, pool);
+    std::cout << serial.bin_count() << ' ' << serial.item_count() << ' '
+              << serial.items().size() << ' ';
+    const auto &l = serial.items();
+    const auto &r = pooled.items();
+    return serial.bin_count() == pooled.bin_count() &&
+           serial.item_count() == pooled.item_count() &&
+           serial.slack() == pooled.slack() &&
+           serial.lower_bound() == pooled.lower_bound() &&
+           std::equal(l.cbegin(), l.cend(), r.cbegin(), r.cend(),
+                      [](const auto &lhs, const auto &rhs) {
+                          return lhs.size == rhs.size &&
+                                 lhs.count == rhs.count;
+                      });
+}
+
+static std::vector<std::uint32_t> sizes(optimizer::Environment *env,
+                                        std::uint32_t n, std::uint32_t c) {
+    std::vector<std::uint32_t> result(n);
+    for (auto &size : result) {
+        size = 1u + optimizer::bounded_rand(c, *env->rng());
+    }
+    return result;
+}
+
+int main() {
+    optimizer::Environment env(42u);
+    optimizer::ThreadPool pool(4u);
+
+    std::cout << test_hcount({8u}, 8u) << '\n';
+    std::cout << test_hcount({3u, 1u, 3u, 8u, 2u, 3u, 1u}, 8u) << '\n';
+    std::cout << test_hcount({5u, 5u, 5u, 5u}, 5u) << '\n';
+    std::cout << test_hcount(sizes(&env, 1000u, 100u), 100u) << '\n';
+    std::cout << test_hcount(sizes(&env, 100u, 100000u), 100000u) << '\n';
+    std::cout << test_stream({4u, 7u, 4u, 2u, 7u, 7u}, 8u) << '\n';
+    std::cout << test_stream(sizes(&env, 1000u, 50u), 50u) << '\n';
+    std::cout << test_stream(sizes(&env, 1000u, 1u << 30u), 1u << 30u)
+              << '\n';
+    std::cout << test_parallel(&pool, sizes(&env, 100000u, 1000u), 1000u)
+              << '\n';
+    std::cout << test_parallel(&pool, sizes(&env, 1u << 20u, 50000u), 50000u)
+              << '\n';
+    std::cout << test_parallel(&pool, sizes(&env, 70000u, 30000u), 30000u)
+              << '\n';
+    std::cout << test_reduction(&env, &pool) << '\n';
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "environment.h"
+#include "lower_bound.h"
+#include "util.h"
+
+typedef std::vector<std::pair<std::uint32_t, std::uint32_t>> Bins;
+
+/*
+ * First Fit with a maximum of two items per bin, one item at a time, as
+ * `Fitter::fit` packed them before it packed runs in bulk.
+ */
+static Bins reference_fit(
+    const std::vector<std::pair<std::uint32_t, std::uint32_t>> &data,
+    std::uint32_t c) {
+    Bins bins;
+    for (const auto &e : data) {
+        for (auto i = 0u; i < e.second; ++i) {
+            auto it = bins.begin();
+            while (it != bins.end() &&
+                   (it->second || it->first > c - e.first)) {
+                ++it;
+            }
+            if (it == bins.end()) {
+                bins.emplace_back(e.first, 0u);
+            } else {
+                it->second = e.first;
+            }
+        }
+    }
+    return bins;
+}
+
+static Bins
+fit(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &data,
+    std::uint32_t c) {
+    auto n = 0u;
+    for (const auto &e : data) {
+        n += e.second;
+    }
+    optimizer::Fitter fitter(n, c);
+    for (const auto &e : data) {
+        fitter.fit_many(e.first, e.second);
+    }
+    return fitter.bins();
+}
+
+static std::uint32_t
+test_fit(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &data,
+         std::uint32_t c) {
+    const auto bins = fit(data, c);
+    return bins == reference_fit(data, c) ? bins.size() : 0u;
+}
+
+/*
+ * Returns the number of random instances, each with runs of decreasing
+ * sizes up to c, on which `Fitter` and the reference disagree.
+ */
+static std::uint32_t test_random(optimizer::Environment *env,
+                                 std::uint32_t instances, std::uint32_t c) {
+    auto &rng = *env->rng();
+    auto mismatches = 0u;
+    for (auto i = 0u; i < instances; ++i) {
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> data;
+        for (auto size = c; size > 0u; --size) {
+            if (!optimizer::bounded_rand(4u, rng)) {
+                data.emplace_back(size, 1u + optimizer::bounded_rand(6u, rng));
+            }
+        }
+        mismatches += fit(data, c) != reference_fit(data, c);
+    }
+    return mismatches;
+}
+
+int main() {
+    optimizer::Environment env(42u);
+
+    std::cout << test_fit({std::make_pair(7u, 3u), std::make_pair(3u, 2u),
+                           std::make_pair(1u, 4u)},
+                          8u)
+              << '\n';
+    std::cout << test_fit({std::make_pair(6u, 2u), std::make_pair(4u, 5u),
+                           std::make_pair(2u, 3u)},
+                          8u)
+              << '\n';
+    std::cout << test_fit({std::make_pair(5u, 1u), std::make_pair(3u, 7u)},
+                          10u)
+              << '\n';
+    std::cout << test_fit({std::make_pair(9u, 2u), std::make_pair(5u, 3u),
+                           std::make_pair(5u, 2u), std::make_pair(1u, 9u)},
+                          10u)
+              << '\n';
+    std::cout << test_fit({std::make_pair(50u, 1000u)}, 100u) << '\n';
+    std::cout << test_random(&env, 1000u, 20u) << '\n';
+    std::cout << test_random(&env, 200u, 200u) << '\n';
+
+    return 0;
+}
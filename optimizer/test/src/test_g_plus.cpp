@@ -0,0 +1,125 @@
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "environment.h"
+#include "problem.h"
+// operators need the complete `Problem`
+#include "operators.h"
+#include "solution.h"
+#include "util.h"
+
+/*
+ * Determines if solution packs every item of problem exactly once, into
+ * blocks which hold their items and use all the bins.
+ */
+static bool valid(const optimizer::Problem &problem,
+                  const optimizer::Solution &solution) {
+    std::vector<std::uint32_t> counts(problem.items().size());
+    auto bins = 0u;
+    for (const auto &block : solution.blocks()) {
+        const auto items = solution.items(block);
+        auto size = 0u;
+        for (auto it = items.first; it != items.second; ++it) {
+            if (*it >= counts.size()) {
+                return false;
+            }
+            ++counts[*it];
+            size += problem.items()[*it].size;
+        }
+        if (size != block.size() ||
+            size > block.bin_count() * problem.bin_capacity()) {
+            return false;
+        }
+        bins += block.bin_count();
+    }
+    for (auto i = 0u; i < counts.size(); ++i) {
+        if (counts[i] != problem.items()[i].count) {
+            return false;
+        }
+    }
+    return bins == problem.bin_count();
+}
+
+/*
+ * The numbers of blocks of a number of solutions, and how many of them were
+ * not valid.
+ */
+struct Outcome {
+    double sum;
+    double squares;
+    std::uint32_t runs;
+    std::uint32_t invalid;
+
+    Outcome() : sum{}, squares{}, runs{}, invalid{} {}
+    void add(const optimizer::Problem &problem,
+             const optimizer::Solution &solution) {
+        sum += solution.size();
+        squares += static_cast<double>(solution.size()) * solution.size();
+        ++runs;
+        invalid += !valid(problem, solution);
+    }
+    double mean() const { return sum / runs; }
+    double variance() const { return squares / runs - mean() * mean(); }
+};
+
+/*
+ * Makes runs solutions with G+ alone, counted in generated, and mutates
+ * each of them, counted in mutated.
+ */
+static void run(optimizer::Problem *problem, bool sample, std::uint32_t runs,
+                Outcome *generated, Outcome *mutated) {
+    problem->set_sample_items(sample);
+    auto context = problem->context();
+    for (auto i = 0u; i < runs; ++i) {
+        auto solution = problem->generate_individual<false>(&context);
+        generated->add(*problem, *solution);
+        // mutation with B3 leaves the items of unpacked blocks loose
+        optimizer::adaptive_mutation<true>(problem, &context, 1.3,
+                                           solution.get());
+        mutated->add(*problem, *solution);
+    }
+}
+
+/*
+ * Determines if the mean numbers of blocks of two outcomes agree to within
+ * four standard errors.
+ */
+static bool agree(const Outcome &lhs, const Outcome &rhs) {
+    const auto error = std::sqrt(lhs.variance() / lhs.runs +
+                                 rhs.variance() / rhs.runs);
+    return std::fabs(lhs.mean() - rhs.mean()) <= 4.0 * error;
+}
+
+/*
+ * Prints the number of invalid solutions made with items shuffled and with
+ * items sampled, and whether their numbers of blocks agree, for G+ alone and
+ * after mutation.
+ */
+static void test_g_plus(optimizer::Environment *env, std::uint32_t n,
+                        std::uint32_t c, std::uint32_t runs) {
+    std::vector<std::uint32_t> sizes(n);
+    for (auto &size : sizes) {
+        size = 1u + optimizer::bounded_rand(c, *env->rng());
+    }
+    optimizer::Problem problem(env, sizes.cbegin(), sizes.cend(), c);
+    Outcome shuffled[2], sampled[2];
+    run(&problem, false, runs, &shuffled[0], &shuffled[1]);
+    run(&problem, true, runs, &sampled[0], &sampled[1]);
+    std::cout << shuffled[0].invalid + shuffled[1].invalid << ' '
+              << sampled[0].invalid + sampled[1].invalid << ' '
+              << agree(shuffled[0], sampled[0]) << ' '
+              << agree(shuffled[1], sampled[1]) << '\n';
+}
+
+int main() {
+    optimizer::Environment env(42u);
+
+    test_g_plus(&env, 50u, 20u, 2000u);
+    test_g_plus(&env, 300u, 100u, 1000u);
+    test_g_plus(&env, 2000u, 1000u, 1000u);
+
+    return 0;
+}
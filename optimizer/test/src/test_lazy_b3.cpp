@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "environment.h"
+#include "item.h"
+#include "problem.h"
+#include "solution.h"
+#include "threesum.h"
+
+/*
+ * Builds a problem with at least as many distinct sizes as a `Partition`
+ * can index, so B3 finds its 3-partitions lazily: all sizes from 1 to
+ * `Partition::max_items` once, and count sizes just below half the bin
+ * capacity, any two of which leave room for a small one. Returns the
+ * number of bins B3 packs into a solution with no blocks, and prints
+ * whether the problem keeps no table of 3-partitions.
+ */
+static std::uint32_t test_lazy_b3(optimizer::Environment *env,
+                                  std::uint32_t count) {
+    const auto c = 8u * optimizer::Partition::max_items;
+    std::vector<optimizer::ItemCount> sizes;
+    for (auto k = 1u; k <= count; ++k) {
+        sizes.emplace_back(c / 2u - k, 1u);
+    }
+    for (auto size = optimizer::Partition::max_items; size > 0u; --size) {
+        sizes.emplace_back(size, 1u);
+    }
+
+    optimizer::Problem problem(env, sizes, c);
+    auto context = problem.context();
+    std::cout << context.partitions().empty() << ' ';
+
+    optimizer::Solution solution;
+    auto slack = problem.slack();
+    auto item_count = problem.item_count();
+    const auto bins = problem.b3(&context, &slack, &item_count, &solution);
+    return bins == solution.size() && item_count < problem.item_count()
+               ? bins
+               : 0u;
+}
+
+int main() {
+    optimizer::Environment env(42u);
+
+    std::cout << (test_lazy_b3(&env, 2u) == 1u) << '\n';
+    std::cout << (test_lazy_b3(&env, 100u) > 0u) << '\n';
+
+    return 0;
+}
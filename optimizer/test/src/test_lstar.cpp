@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "environment.h"
+#include "item.h"
+#include "lower_bound.h"
+#include "util.h"
+
+typedef std::vector<optimizer::ItemCount> Items;
+
+/*
+ * Computes the bound L_*^(k) for a single k over items sorted by increasing
+ * size, one value of u at a time, as `lstar` did before it took k in lanes.
+ */
+static std::uint64_t reference_lstar(const Items &items, std::uint32_t c,
+                                     std::uint32_t k) {
+    const auto right = std::upper_bound(
+        items.cbegin(), items.cend(), c / 2u,
+        [](std::uint32_t lhs, const auto &rhs) { return lhs < rhs.size; });
+    const auto capacity = std::uint64_t{c} * k;
+    const auto ceiling = [capacity](std::uint64_t total) {
+        return total ? 1u + (total - 1u) / capacity : total;
+    };
+
+    auto total = std::uint64_t{};
+    for (const auto &item : items) {
+        total += item.count * optimizer::u(k, item.size, c);
+    }
+    auto maximum = ceiling(total);
+
+    auto rit = items.crbegin();
+    auto prev = items.cbegin();
+    for (auto it = items.cbegin(); it != right; ++it) {
+        for (; rit->size > c - it->size; ++rit) {
+            total += rit->count * (capacity - optimizer::u(k, rit->size, c));
+        }
+        if (it != items.cbegin()) {
+            total -= prev->count * optimizer::u(k, prev->size, c);
+            ++prev;
+            if (ceiling(total) < maximum) {
+                break;
+            }
+        }
+        maximum = std::max(ceiling(total), maximum);
+    }
+    return maximum;
+}
+
+/*
+ * Returns the greatest bound over k from first to last as computed in lanes
+ * by `lstar`, or 0 if it differs from the reference.
+ */
+static std::uint32_t test_lstar(const Items &items, std::uint32_t c,
+                                std::uint32_t first, std::uint32_t last) {
+    const auto right = std::upper_bound(
+        items.cbegin(), items.cend(), c / 2u,
+        [](std::uint32_t lhs, const auto &rhs) { return lhs < rhs.size; });
+    auto expected = std::uint64_t{};
+    for (auto k = first; k <= last; ++k) {
+        expected = std::max(expected, reference_lstar(items, c, k));
+    }
+    const auto result =
+        optimizer::lstar(items.cbegin(), right, items.cend(), c, first, last);
+    return result == expected ? result : 0u;
+}
+
+/*
+ * Returns the number of random instances with sizes up to c, and of ranges
+ * of k from 2 to iterations, on which `lstar` and the reference disagree.
+ */
+static std::uint32_t test_random(optimizer::Environment *env,
+                                 std::uint32_t instances, std::uint32_t c,
+                                 std::uint32_t iterations) {
+    auto &rng = *env->rng();
+    auto mismatches = 0u;
+    for (auto i = 0u; i < instances; ++i) {
+        Items items;
+        for (auto size = 1u; size <= c; ++size) {
+            if (!optimizer::bounded_rand(3u, rng)) {
+                items.emplace_back(size,
+                                   1u + optimizer::bounded_rand(20u, rng));
+            }
+        }
+        if (items.empty()) {
+            continue;
+        }
+        for (auto first = 2u; first <= iterations;
+             first += optimizer::lstar_lanes) {
+            const auto last =
+                std::min(first + optimizer::lstar_lanes - 1u, iterations);
+            mismatches += !test_lstar(items, c, first, last);
+        }
+    }
+    return mismatches;
+}
+
+int main() {
+    optimizer::Environment env(42u);
+
+    std::cout << test_lstar({{1u, 10u}, {2u, 4u}, {3u, 22u}, {4u, 1u}}, 8u, 2u,
+                            17u)
+              << '\n';
+    std::cout << test_lstar({{2u, 4u}, {4u, 1u}, {7u, 4u}}, 8u, 2u, 17u)
+              << '\n';
+    std::cout << test_lstar({{3u, 5u}, {6u, 1u}, {7u, 5u}}, 8u, 2u, 2u)
+              << '\n';
+    std::cout << test_lstar({{3u, 1u}, {7u, 1u}, {11u, 1u}, {33u, 3u},
+                             {50u, 1u}, {60u, 1u}, {70u, 1u}},
+                            100u, 5u, 20u)
+              << '\n';
+    std::cout << test_lstar({{2u, 1000u}, {33u, 6000u}}, 100u, 18u, 20u)
+              << '\n';
+    std::cout << test_random(&env, 500u, 30u, 20u) << '\n';
+    std::cout << test_random(&env, 100u, 1000u, 40u) << '\n';
+
+    return 0;
+}